@@ -58,83 +58,95 @@
   last2=last1; \
   last1=nextDec; \
 
-void brrEncodeBlock(const short* buf, unsigned char* out, unsigned char range, unsigned char filter, short* last1, short* last2, int* errorSum) {
-  // encode one block using BRR
-  unsigned char nibble=0;
-  int preOut=0;
-  int pred=0;
-  int nextDec=0;
-  int nextError=0;
-  *errorSum=0;
-  for (int j=0; j<16; j++) {
-    short s=NEXT_SAMPLE;
-    switch (filter) {
-      case 0: // no filter
-        pred=s;
-        break;
-      case 1: // simple
-        pred=s-(((int)(*last1*2)*15)>>4);
-        break;
-      case 2: // complex
-        pred=s+(((int)(*last2*2)*15)>>4)-(((int)(*last1*2)*61)>>5);
-        break;
-      case 3:
-        pred=s+(((int)(*last2*2)*13)>>4)-(((int)(*last1*2)*115)>>6);
-        break;
-    }
-
-    if (pred<-32768) pred=-32768;
-    if (pred>32767) pred=32767;
-
-    preOut=pred>>range;
-    if (range) {
-      if (pred&(1<<(range>>1))) preOut++;
-      if (filter==0 && range>=12) if (preOut<-7) preOut=-7;
-    }
-    if (preOut>7) preOut=7;
-    if (preOut<-8) preOut=-8;
-
-    nibble=preOut&15;
-    if (j&1) {
-      out[j>>1]|=nibble;
-    } else {
-      out[j>>1]=nibble<<4;
-    }
-
-    // roll last1/last2
-    nextDec=nibble;
-    if (nextDec&8) nextDec|=0xfffffff0;
-
-    if (range>=13) { /* invalid shift */
-      nextDec=(nextDec<0)?0xfffff800:0;
-    } else {
-      nextDec<<=range; /* range */
-      nextDec>>=1;
-    }
+// all 13 ranges of a filter are tried at once.
+// every lane (range) is independent and the filter is fixed for the whole block,
+// so the inner loops contain no branches and can be vectorized by the compiler.
+#define BRR_LANES 16
+
+// the lane loop needs per-lane shifts and 32-bit multiplies, which are only
+// available as vector instructions since AVX2. build an AVX2 version as well
+// and pick one at run-time where the toolchain supports it.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+#define BRR_ENCODE_TARGETS __attribute__((target_clones("avx2","default")))
+#else
+#define BRR_ENCODE_TARGETS
+#endif
+
+// predictor/decoder coefficients for each filter.
+// filter 0 has all of them set to 0.
+static const int brrPredMul1[4]={0,15,61,115};
+static const int brrPredShift1[4]={0,4,5,6};
+static const int brrPredMul2[4]={0,0,15,13};
+static const int brrPredShift2[4]={0,0,4,4};
+static const int brrDecMul1[4]={0,1,2,2};
+static const int brrDecFrac1[4]={0,1,3,13};
+static const int brrDecShift1[4]={0,4,5,6};
+static const int brrDecMul2[4]={0,0,1,1};
+static const int brrDecFrac2[4]={0,0,1,3};
+static const int brrDecShift2[4]={0,0,4,4};
+
+// per-lane range and rounding bit (ranges 13-15 are padding and never picked).
+static const int brrLaneRange[BRR_LANES]={0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+static const int brrLaneRound[BRR_LANES]={0,1,2,2,4,4,8,8,16,16,32,32,64,64,128,128};
+
+BRR_ENCODE_TARGETS
+void brrEncodeFilter(const short* buf, signed char nibbles[16][BRR_LANES], unsigned char filter, short last1, short last2, short* outLast1, short* outLast2, int* errorSum) {
+  // encode one block using BRR with every range
+  int l1[BRR_LANES];
+  int l2[BRR_LANES];
+  int err[BRR_LANES];
+
+  const int pm1=brrPredMul1[filter];
+  const int ps1=brrPredShift1[filter];
+  const int pm2=brrPredMul2[filter];
+  const int ps2=brrPredShift2[filter];
+  const int dm1=brrDecMul1[filter];
+  const int df1=brrDecFrac1[filter];
+  const int ds1=brrDecShift1[filter];
+  const int dm2=brrDecMul2[filter];
+  const int df2=brrDecFrac2[filter];
+  const int ds2=brrDecShift2[filter];
+  int low[BRR_LANES];
+
+  for (int k=0; k<BRR_LANES; k++) {
+    l1[k]=last1;
+    l2[k]=last2;
+    err[k]=0;
+    low[k]=(filter==0 && k>=12)?-7:-8;
+  }
 
-    switch (filter) { /* filter */
-      case 0:
-        break;
-      case 1:
-        nextDec+=(*last1)+((-(*last1))>>4);
-        break;
-      case 2:
-        nextDec+=(*last1)*2+((-(*last1)*3)>>5)-(*last2)+((*last2)>>4);
-        break;
-      case 3:
-        nextDec+=(*last1)*2+((-(*last1)*13)>>6)-(*last2)+(((*last2)*3)>>4);
-        break;
+  for (int j=0; j<16; j++) {
+    const int s=(short)(NEXT_SAMPLE);
+    signed char* nibOut=nibbles[j];
+    for (int k=0; k<BRR_LANES; k++) {
+      int pred=s+(((l2[k]*2)*pm2)>>ps2)-(((l1[k]*2)*pm1)>>ps1);
+      if (pred<-32768) pred=-32768;
+      if (pred>32767) pred=32767;
+
+      int preOut=pred>>brrLaneRange[k];
+      if (pred&brrLaneRound[k]) preOut++;
+      if (preOut>7) preOut=7;
+      if (preOut<low[k]) preOut=low[k];
+      nibOut[k]=preOut;
+
+      // roll last1/last2
+      int nextDec=(preOut<<brrLaneRange[k])>>1;
+      nextDec+=l1[k]*dm1+((-l1[k]*df1)>>ds1)-l2[k]*dm2+((l2[k]*df2)>>ds2);
+      nextDec=((nextDec&0x7fff)^0x4000)-0x4000;
+
+      int nextError=s-(nextDec<<1);
+      if (nextError<0) nextError=-nextError;
+      err[k]+=nextError;
+
+      l2[k]=l1[k];
+      l1[k]=nextDec;
     }
+  }
 
-    nextDec&=0x7fff;
-    if (nextDec&0x4000) nextDec|=0xffff8000;
-
-    nextError=s-(nextDec<<1);
-    if (nextError<0) nextError=-nextError;
-    *errorSum+=nextError;
-
-    *last2=*last1;
-    *last1=nextDec;
+  for (int k=0; k<13; k++) {
+    outLast1[k]=l1[k];
+    outLast2[k]=l2[k];
+    errorSum[k]=err[k];
   }
 }
 
@@ -165,16 +177,18 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
 
   short in[17];
 
-  short last1[4][13];
-  short last2[4][13];
+  short last1=0;
+  short last2=0;
+  short nextLast1[4][13];
+  short nextLast2[4][13];
   int avgError[4][13];
-  unsigned char possibleOut[4][13][8];
+  signed char possibleOut[4][16][BRR_LANES];
 
   memset(in,0,16*sizeof(short));
-  memset(last1,0,4*13*sizeof(short));
-  memset(last2,0,4*13*sizeof(short));
+  memset(nextLast1,0,4*13*sizeof(short));
+  memset(nextLast2,0,4*13*sizeof(short));
   memset(avgError,0,4*13*sizeof(int));
-  memset(possibleOut,0,4*13*8);
+  memset(possibleOut,0,sizeof(possibleOut));
 
   for (long i=0; i<len; i+=16) {
     if (i+17>len) {
@@ -210,11 +224,9 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
       }
     }
 
-    // encode
-    for (int j=0; j<4; j++) {
-      for (int k=0; k<13; k++) {
-        brrEncodeBlock(in,possibleOut[j][k],k,j,&last1[j][k],&last2[j][k],&avgError[j][k]);
-      }
+    // encode (the first block is always unfiltered)
+    for (int j=0; j<((i==0)?1:4); j++) {
+      brrEncodeFilter(in,possibleOut[j],j,last1,last2,nextLast1[j],nextLast2[j],avgError[j]);
     }
 
     // find best filter/range
@@ -242,15 +254,11 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
     // write
     out[0]=(range<<4)|(filter<<2)|((i+16>=len && loopStart<0)?1:0);
     for (int j=0; j<8; j++) {
-      out[j+1]=possibleOut[filter][range][j];
+      out[j+1]=((possibleOut[filter][j<<1][range]&15)<<4)|(possibleOut[filter][(j<<1)+1][range]&15);
     }
 
-    for (int j=0; j<4; j++) {
-      for (int k=0; k<13; k++) {
-        last1[j][k]=last1[filter][range];
-        last2[j][k]=last2[filter][range];
-      }
-    }
+    last1=nextLast1[filter][range];
+    last2=nextLast2[filter][range];
     out+=9;
     total+=9;
   }
@@ -280,9 +288,7 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
 
     // encode (filter 0/1 only)
     for (int j=0; j<2; j++) {
-      for (int k=0; k<13; k++) {
-        brrEncodeBlock(in,possibleOut[j][k],k,j,&last1[j][k],&last2[j][k],&avgError[j][k]);
-      }
+      brrEncodeFilter(in,possibleOut[j],j,last1,last2,nextLast1[j],nextLast2[j],avgError[j]);
     }
 
     // find best filter/range
@@ -300,15 +306,11 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
     // write
     out[0]=(range<<4)|(filter<<2)|3;
     for (int j=0; j<8; j++) {
-      out[j+1]=possibleOut[filter][range][j];
+      out[j+1]=((possibleOut[filter][j<<1][range]&15)<<4)|(possibleOut[filter][(j<<1)+1][range]&15);
     }
 
-    for (int j=0; j<4; j++) {
-      for (int k=0; k<13; k++) {
-        last1[j][k]=last1[filter][range];
-        last2[j][k]=last2[filter][range];
-      }
-    }
+    last1=nextLast1[filter][range];
+    last2=nextLast2[filter][range];
     out+=9;
     total+=9;
   }
@@ -318,26 +320,15 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
 #define DO_ONE_SAMPLE \
   if (next&8) next|=0xfffffff0; \
 \
-  if (buf[0]>=0xd0) { /* invalid shift */ \
+  if (invalidShift) { \
     next=(next<0)?0xfffff800:0; \
   } else { \
-    next<<=(buf[0]>>4); /* range */ \
+    next<<=shift; /* range */ \
     next>>=1; \
   } \
 \
-  switch (control&0xc) { /* filter */ \
-    case 0: \
-      break; \
-    case 4: \
-      next+=last1+((-last1)>>4); \
-      break; \
-    case 8: \
-      next+=last1*2+((-last1*3)>>5)-last2+(last2>>4); \
-      break; \
-    case 12: \
-      next+=last1*2+((-last1*13)>>6)-last2+((last2*3)>>4); \
-      break; \
-  } \
+  /* filter */ \
+  next+=last1*dm1+((-last1*df1)>>ds1)-last2*dm2+((last2*df2)>>ds2); \
 \
   if (next>32767) next=32767; \
   if (next<-32768) next=-32768; \
@@ -365,6 +356,15 @@ long brrDecode(unsigned char* buf, short* out, long len, unsigned char emphasis)
 
   for (long i=0; i<len; i+=9) {
     unsigned char control=buf[0];
+    const unsigned char filter=(control>>2)&3;
+    const int shift=control>>4;
+    const int invalidShift=(control>=0xd0);
+    const int dm1=brrDecMul1[filter];
+    const int df1=brrDecFrac1[filter];
+    const int ds1=brrDecShift1[filter];
+    const int dm2=brrDecMul2[filter];
+    const int df2=brrDecFrac2[filter];
+    const int ds2=brrDecShift2[filter];
 
     for (unsigned char j=1; j<9; j++) {
       next=buf[j]>>4;
@@ -23,20 +23,20 @@
 #include "engine.h"
 #include "../ta-log.h"
 
-bool DivCSChannelState::doCall(unsigned int addr) {
+bool DivCSChannelState::doCall(unsigned int addr, unsigned int retAddr) {
   if (callStackPos>=8) {
     readPos=0;
     return false;
   }
 
-  callStack[callStackPos++]=readPos;
+  callStack[callStackPos++]=retAddr;
   readPos=addr;
 
   return true;
 }
 
 void DivCSPlayer::cleanup() {
-  delete b;
+  delete[] b;
 }
 
 bool DivCSPlayer::tick() {
@@ -46,8 +46,6 @@ bool DivCSPlayer::tick() {
     bool sendPitch=false;
     if (chan[i].readPos==0) continue;
 
-    ticked=true;
-
     chan[i].waitTicks--;
     while (chan[i].waitTicks<=0) {
       if (!stream.seek(chan[i].readPos,SEEK_SET)) {
@@ -57,6 +55,7 @@ bool DivCSPlayer::tick() {
       }
       unsigned char next=stream.readC();
       unsigned char command=0;
+      bool jumped=false;
 
       if (next<0xb3) { // note
         e->dispatchCmd(DivCommand(DIV_CMD_NOTE_ON,i,(int)next-60));
@@ -88,25 +87,38 @@ bool DivCSPlayer::tick() {
         case 0xf7:
           command=stream.readC();
           break;
+        case 0xf3: { // raw command
+          unsigned char rawChan=stream.readC();
+          unsigned char rawCmd=stream.readC();
+          int rawVal=stream.readI();
+          int rawVal2=stream.readI();
+          if (rawChan<e->getTotalChannelCount()) {
+            e->dispatchCmd(DivCommand((DivDispatchCmds)rawCmd,rawChan,rawVal,rawVal2));
+          }
+          break;
+        }
         case 0xf8: {
           unsigned int callAddr=chan[i].readPos+2+stream.readS();
-          if (!chan[i].doCall(callAddr)) {
+          if (!chan[i].doCall(callAddr,stream.tell())) {
             logE("%d: (callb16) stack error!",i);
           }
+          jumped=true;
           break;
         }
         case 0xf6: {
           unsigned int callAddr=chan[i].readPos+4+stream.readI();
-          if (!chan[i].doCall(callAddr)) {
+          if (!chan[i].doCall(callAddr,stream.tell())) {
             logE("%d: (callb32) stack error!",i);
           }
+          jumped=true;
           break;
         }
         case 0xf5: {
           unsigned int callAddr=stream.readI();
-          if (!chan[i].doCall(callAddr)) {
+          if (!chan[i].doCall(callAddr,stream.tell())) {
             logE("%d: (call) stack error!",i);
           }
+          jumped=true;
           break;
         }
         case 0xf4: {
@@ -121,13 +133,14 @@ bool DivCSPlayer::tick() {
             break;
           }
           chan[i].readPos=chan[i].callStack[--chan[i].callStackPos];
+          jumped=true;
           break;
         case 0xfa:
           chan[i].readPos=stream.readI();
+          jumped=true;
           break;
         case 0xfb:
-          logE("TODO: RATE");
-          stream.readI();
+          e->divider=(double)stream.readI()/65536.0;
           break;
         case 0xfc:
           chan[i].waitTicks=(unsigned short)stream.readS();
@@ -149,6 +162,8 @@ bool DivCSPlayer::tick() {
       }
 
       if (chan[i].readPos==0) break;
+      // readPos already points to the destination
+      if (jumped) continue;
 
       if (command) {
         int arg0=0;
@@ -360,6 +375,8 @@ bool DivCSPlayer::tick() {
       }
       chan[i].arpTicks--;
     }
+
+    if (chan[i].readPos!=0) ticked=true;
   }
 
   return ticked;
@@ -406,8 +423,123 @@ bool DivCSPlayer::init() {
 
 // DivEngine
 
+bool DivEngine::compileCommandStream() {
+  if (cmdStreamCacheValid && cmdStreamCache!=NULL && cmdStreamCacheSubSong==curSubSongIndex) return true;
+  if (cmdStreamCache!=NULL) {
+    delete[] cmdStreamCache;
+    cmdStreamCache=NULL;
+    cmdStreamCacheLen=0;
+  }
+  cmdStreamCacheValid=false;
+
+  logD("compiling command stream...");
+  SafeWriter* w=saveCommand(true,true);
+  if (w==NULL) return false;
+  cmdStreamCacheLen=w->size();
+  cmdStreamCache=new unsigned char[cmdStreamCacheLen];
+  memcpy(cmdStreamCache,w->getFinalBuf(),cmdStreamCacheLen);
+  w->finish();
+  delete w;
+  cmdStreamCacheSubSong=curSubSongIndex;
+  cmdStreamCacheValid=true;
+  return true;
+}
+
+bool DivEngine::startCommandStream() {
+  stopCommandStream();
+  if (cmdStreamCache==NULL) return false;
+  reset();
+  // the player takes ownership of the buffer
+  unsigned char* buf=new unsigned char[cmdStreamCacheLen];
+  memcpy(buf,cmdStreamCache,cmdStreamCacheLen);
+  cmdStreamInt=new DivCSPlayer(this,buf,cmdStreamCacheLen);
+  if (!cmdStreamInt->init()) {
+    logE("could not start precompiled playback!");
+    cmdStreamInt->cleanup();
+    delete cmdStreamInt;
+    cmdStreamInt=NULL;
+    return false;
+  }
+  cmdStreamSong=true;
+  cmdStreamTick=0;
+  freelance=false;
+  playing=true;
+  return true;
+}
+
+void DivEngine::stopCommandStream() {
+  if (cmdStreamInt!=NULL) {
+    cmdStreamInt->cleanup();
+    delete cmdStreamInt;
+    cmdStreamInt=NULL;
+  }
+  cmdStreamSong=false;
+}
+
+#define LOOP_STATE(x) cmdStreamLoop.x=x;
+#define LOOP_STATE_ALL \
+  LOOP_STATE(speeds) \
+  LOOP_STATE(subticks) \
+  LOOP_STATE(ticks) \
+  LOOP_STATE(curRow) \
+  LOOP_STATE(curOrder) \
+  LOOP_STATE(prevRow) \
+  LOOP_STATE(prevOrder) \
+  LOOP_STATE(nextSpeed) \
+  LOOP_STATE(elapsedBars) \
+  LOOP_STATE(elapsedBeats) \
+  LOOP_STATE(curSpeed) \
+  LOOP_STATE(stepPlay) \
+  LOOP_STATE(changeOrd) \
+  LOOP_STATE(changePos) \
+  LOOP_STATE(globalPitch) \
+  LOOP_STATE(divider) \
+  LOOP_STATE(tempoAccum) \
+  LOOP_STATE(extValue) \
+  LOOP_STATE(extValuePresent) \
+  LOOP_STATE(endOfSong) \
+  LOOP_STATE(shallStopSched)
+
+void DivEngine::storeCommandStreamLoop() {
+  LOOP_STATE_ALL;
+  for (int i=0; i<chans; i++) {
+    cmdStreamLoop.chan[i]=chan[i];
+  }
+  memcpy(cmdStreamLoop.walked,walked,8192);
+  cmdStreamLoop.arpLen=curSubSong->arpLen;
+}
+
+#undef LOOP_STATE
+#define LOOP_STATE(x) x=cmdStreamLoop.x;
+
+void DivEngine::restoreCommandStreamLoop() {
+  LOOP_STATE_ALL;
+  for (int i=0; i<chans; i++) {
+    chan[i]=cmdStreamLoop.chan[i];
+  }
+  memcpy(walked,cmdStreamLoop.walked,8192);
+  curSubSong->arpLen=cmdStreamLoop.arpLen;
+}
+
+#undef LOOP_STATE
+#undef LOOP_STATE_ALL
+
+void DivEngine::invalidateCommandStream() {
+  cmdStreamCacheValid=false;
+  songRev++;
+}
+
+void DivEngine::setPrecompiledPlayback(bool enable) {
+  precompiledPlayback=enable;
+}
+
+bool DivEngine::getPrecompiledPlayback() {
+  return precompiledPlayback;
+}
+
 bool DivEngine::playStream(unsigned char* f, size_t length) {
   BUSY_BEGIN;
+  stopCommandStream();
   cmdStreamInt=new DivCSPlayer(this,f,length);
   if (!cmdStreamInt->init()) {
     logE("not a command stream!");
@@ -45,7 +45,7 @@ struct DivCSChannelState {
   } trace[32];
   unsigned char tracePos;
 
-  bool doCall(unsigned int addr);
+  bool doCall(unsigned int addr, unsigned int retAddr);
 
   DivCSChannelState():
     readPos(0),
@@ -78,6 +78,7 @@ class DivCSPlayer {
   short vibTable[64];
   public:
     void cleanup();
+    // returns false once every channel has stopped.
     bool tick();
     bool init();
     DivCSPlayer(DivEngine* en, unsigned char* buf, size_t len):
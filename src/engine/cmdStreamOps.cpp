@@ -19,6 +19,17 @@
 
 #include "engine.h"
 #include "../ta-log.h"
+#include <unordered_map>
+#include <algorithm>
+
+// minimum length (in instructions) of a repeated sequence to be considered for a sub-block
+#define CMD_STREAM_BLOCK_MIN 4
+// maximum number of sub-blocks
+#define CMD_STREAM_BLOCK_MAX 4096
+// maximum number of passes over the streams when looking for sub-blocks
+#define CMD_STREAM_BLOCK_PASSES 16
+// size of a call instruction (0xf5 + address)
+#define CMD_STREAM_CALL_SIZE 5
 
 #define WRITE_TICK(x) \
   if (binary) { \
@@ -205,7 +216,156 @@ void writePackedCommandValues(SafeWriter* w, const DivCommand& c) {
   }
 }
 
-SafeWriter* DivEngine::saveCommand(bool binary) {
+// find repeated instruction sequences across all channels and move them into shared sub-blocks.
+// each channel is a list of instruction IDs. a negative ID means "call sub-block -ID-1".
+// sub-blocks do not contain calls, so the player's call stack never goes deeper than 1.
+// every pass indexes the sequences once and then extracts as many non-conflicting blocks as it
+// can (best savings first), so the number of passes doesn't grow with the number of blocks.
+static void extractSubBlocks(std::vector<std::vector<int>>& seq, std::vector<std::vector<int>>& blocks, const std::vector<String>& insData, const std::vector<bool>& insBlockable) {
+  struct Candidate {
+    std::vector<std::pair<int,int>> occ;
+    int len;
+    int blockSize;
+    int savings;
+  };
+  struct Replacement {
+    int pos, len, block;
+  };
+  std::unordered_map<uint64_t,std::vector<std::pair<int,int>>> grams;
+  std::vector<Candidate> cands;
+  std::vector<std::pair<int,int>> occ;
+  std::vector<std::vector<bool>> claimed;
+  std::vector<std::vector<Replacement>> repl;
+
+  for (int pass=0; pass<CMD_STREAM_BLOCK_PASSES && blocks.size()<CMD_STREAM_BLOCK_MAX; pass++) {
+    // index every window of CMD_STREAM_BLOCK_MIN instructions
+    grams.clear();
+    for (size_t i=0; i<seq.size(); i++) {
+      std::vector<int>& s=seq[i];
+      int lastBad=-1;
+      for (int j=0; j<(int)s.size(); j++) {
+        if (s[j]<0 || !insBlockable[s[j]]) lastBad=j;
+        int start=j-CMD_STREAM_BLOCK_MIN+1;
+        if (start<=lastBad) continue;
+        uint64_t hash=0xcbf29ce484222325;
+        for (int k=start; k<=j; k++) {
+          hash=(hash^(uint64_t)s[k])*0x100000001b3;
+        }
+        grams[hash].push_back(std::pair<int,int>(i,start));
+      }
+    }
+
+    // collect every sequence which saves bytes
+    cands.clear();
+    for (auto& g: grams) {
+      if (g.second.size()<2) continue;
+      const std::pair<int,int>& ref=g.second[0];
+      const int* refData=&seq[ref.first][ref.second];
+
+      // filter out hash collisions and overlapping occurrences
+      occ.clear();
+      for (std::pair<int,int>& i: g.second) {
+        if (!occ.empty() && occ.back().first==i.first && i.second<occ.back().second+CMD_STREAM_BLOCK_MIN) continue;
+        if (memcmp(refData,&seq[i.first][i.second],CMD_STREAM_BLOCK_MIN*sizeof(int))!=0) continue;
+        occ.push_back(i);
+      }
+      if (occ.size()<2) continue;
+
+      // extend the match for as long as all occurrences agree
+      int len=CMD_STREAM_BLOCK_MIN;
+      while (true) {
+        bool canExtend=true;
+        for (size_t i=0; i<occ.size(); i++) {
+          std::vector<int>& s=seq[occ[i].first];
+          int pos=occ[i].second+len;
+          if (pos>=(int)s.size()) {
+            canExtend=false;
+            break;
+          }
+          if (i+1<occ.size() && occ[i+1].first==occ[i].first && pos>=occ[i+1].second) {
+            canExtend=false;
+            break;
+          }
+          if (s[pos]<0 || !insBlockable[s[pos]] || s[pos]!=refData[len]) {
+            canExtend=false;
+            break;
+          }
+        }
+        if (!canExtend) break;
+        len++;
+      }
+
+      int blockSize=0;
+      for (int i=0; i<len; i++) {
+        blockSize+=insData[refData[i]].size();
+      }
+      int savings=(int)occ.size()*(blockSize-CMD_STREAM_CALL_SIZE)-(blockSize+1);
+      if (savings>0) {
+        cands.push_back(Candidate{occ,len,blockSize,savings});
+      }
+    }
+    if (cands.empty()) break;
+
+    // best savings first. ties are broken by position so that the result doesn't depend on
+    // the hash map's iteration order.
+    std::sort(cands.begin(),cands.end(),[](const Candidate& a, const Candidate& b) {
+      if (a.savings!=b.savings) return a.savings>b.savings;
+      return a.occ[0]<b.occ[0];
+    });
+
+    // take candidates as long as they don't touch instructions taken by a better one
+    claimed.resize(seq.size());
+    repl.resize(seq.size());
+    for (size_t i=0; i<seq.size(); i++) {
+      claimed[i].assign(seq[i].size(),false);
+      repl[i].clear();
+    }
+    bool extracted=false;
+    for (Candidate& c: cands) {
+      if (blocks.size()>=CMD_STREAM_BLOCK_MAX) break;
+      occ.clear();
+      for (std::pair<int,int>& i: c.occ) {
+        std::vector<bool>& cl=claimed[i.first];
+        bool isFree=true;
+        for (int j=i.second; j<i.second+c.len; j++) {
+          if (cl[j]) {
+            isFree=false;
+            break;
+          }
+        }
+        if (isFree) occ.push_back(i);
+      }
+      if ((int)occ.size()*(c.blockSize-CMD_STREAM_CALL_SIZE)-(c.blockSize+1)<=0) continue;
+
+      int blockID=-1-(int)blocks.size();
+      std::vector<int>& firstSeq=seq[occ[0].first];
+      blocks.push_back(std::vector<int>(firstSeq.begin()+occ[0].second,firstSeq.begin()+occ[0].second+c.len));
+      for (std::pair<int,int>& i: occ) {
+        std::vector<bool>& cl=claimed[i.first];
+        for (int j=i.second; j<i.second+c.len; j++) {
+          cl[j]=true;
+        }
+        repl[i.first].push_back(Replacement{i.second,c.len,blockID});
+      }
+      extracted=true;
+    }
+    if (!extracted) break;
+
+    // replace occurrences with calls, from the end so that positions stay valid
+    for (size_t i=0; i<seq.size(); i++) {
+      std::vector<int>& s=seq[i];
+      std::sort(repl[i].begin(),repl[i].end(),[](const Replacement& a, const Replacement& b) {
+        return a.pos>b.pos;
+      });
+      for (Replacement& r: repl[i]) {
+        s.erase(s.begin()+r.pos+1,s.begin()+r.pos+r.len);
+        s[r.pos]=r.block;
+      }
+    }
+  }
+}
+
+SafeWriter* DivEngine::saveCommand(bool binary, bool exact) {
   stop();
   repeatPattern=false;
   shallStop=false;
@@ -227,6 +387,7 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
   unsigned char sortedDelay[16];
   
   SafeWriter* chanStream[DIV_MAX_CHANS];
+  std::vector<size_t> insStart[DIV_MAX_CHANS];
   unsigned int chanStreamOff[DIV_MAX_CHANS];
   bool wroteTick[DIV_MAX_CHANS];
 
@@ -294,8 +455,18 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
 
   memset(lastTick,0,DIV_MAX_CHANS*sizeof(int));
   while (!done) {
+    if (binary && exact && endOfSong) {
+      // the song may loop on this tick
+      storeCommandStreamLoop();
+    }
     if (nextTick(false,true) || !playing) {
       done=true;
+      if (binary && exact && playing) {
+        // the loop is left to pattern playback
+        cmdStreamCacheLoopTick=tick;
+        cmdStream.clear();
+        break;
+      }
     }
     // get command stream
     bool wroteTickGlobal=false;
@@ -311,6 +482,20 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
       }
     }
     for (DivCommand& i: cmdStream) {
+      if (binary && exact) {
+        // hints and queries don't reach the chips
+        if (i.cmd>=DIV_CMD_HINT_VIBRATO && i.cmd<=DIV_CMD_HINT_LEGATO) continue;
+        if (i.cmd==DIV_CMD_HINT_ARP_TIME || i.cmd==DIV_CMD_GET_VOLUME || i.cmd==DIV_CMD_GET_VOLMAX) continue;
+        // everything goes to the first channel, as some chips share registers
+        // between channels and therefore depend on the order of commands.
+        WRITE_TICK(0);
+        chanStream[0]->writeC(0xf3);
+        chanStream[0]->writeC(i.chan);
+        chanStream[0]->writeC(i.cmd);
+        chanStream[0]->writeI(i.value);
+        chanStream[0]->writeI(i.value2);
+        continue;
+      }
       switch (i.cmd) {
         // strip away hinted/useless commands
         case DIV_CMD_GET_VOLUME:
@@ -341,6 +526,14 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
   }
   cmdStreamEnabled=oldCmdStreamEnabled;
 
+  if (binary && exact && !playing) {
+    // stop on the same tick as pattern playback
+    bool wroteTickGlobal=false;
+    tick--;
+    memset(wroteTick,0,DIV_MAX_CHANS*sizeof(bool));
+    WRITE_TICK(0);
+  }
+
   if (binary) {
     int sortCand=-1;
     int sortPos=0;
@@ -391,9 +584,11 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
       SafeReader* reader=oldStream->toReader();
       chanStream[i]=new SafeWriter;
       chanStream[i]->init();
+      insStart[i].clear();
 
       while (1) {
         try {
+          insStart[i].push_back(chanStream[i]->tell());
           unsigned char next=reader->readC();
           switch (next) {
             case 0xb8: // instrument
@@ -418,6 +613,13 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
               next=reader->readC();
               chanStream[i]->writeC(next);
               break;
+            case 0xf3: // raw command
+              chanStream[i]->writeC(next);
+              for (int j=0; j<10; j++) {
+                next=reader->readC();
+                chanStream[i]->writeC(next);
+              }
+              break;
             case 0xf0: { // full command (pre)
               unsigned char cmd=reader->readC();
               bool foundShort=false;
@@ -489,22 +691,85 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
               break;
           }
         } catch (EndOfFileException& e) {
+          insStart[i].pop_back();
           break;
         }
       }
 
       oldStream->finish();
       delete oldStream;
+      delete reader;
     }
 
+    // split streams into instructions
+    std::vector<std::vector<int>> chanIns;
+    std::vector<std::vector<int>> blocks;
+    std::vector<String> insData;
+    std::vector<bool> insBlockable;
+    std::unordered_map<String,int> insMap;
+    size_t sizeBefore=0;
     for (int i=0; i<chans; i++) {
-      chanStreamOff[i]=w->tell();
-      logI("- %d: off %x size %ld",i,chanStreamOff[i],chanStream[i]->size());
-      w->write(chanStream[i]->getFinalBuf(),chanStream[i]->size());
+      chanIns.push_back(std::vector<int>());
+      unsigned char* buf=chanStream[i]->getFinalBuf();
+      size_t size=chanStream[i]->size();
+      sizeBefore+=size;
+      for (size_t j=0; j<insStart[i].size(); j++) {
+        size_t end=(j+1<insStart[i].size())?insStart[i][j+1]:size;
+        String ins((const char*)&buf[insStart[i][j]],end-insStart[i][j]);
+        auto found=insMap.find(ins);
+        if (found==insMap.end()) {
+          insMap[ins]=insData.size();
+          chanIns[i].push_back(insData.size());
+          // don't put stop in a sub-block
+          insBlockable.push_back((unsigned char)ins[0]!=0xff);
+          insData.push_back(ins);
+        } else {
+          chanIns[i].push_back(found->second);
+        }
+      }
       chanStream[i]->finish();
       delete chanStream[i];
     }
 
+    extractSubBlocks(chanIns,blocks,insData,insBlockable);
+
+    // lay out channel data and sub-blocks
+    size_t blockStart=w->tell();
+    for (int i=0; i<chans; i++) {
+      for (int j: chanIns[i]) {
+        blockStart+=(j<0)?CMD_STREAM_CALL_SIZE:insData[j].size();
+      }
+    }
+    std::vector<unsigned int> blockOff;
+    for (std::vector<int>& i: blocks) {
+      blockOff.push_back(blockStart);
+      for (int j: i) {
+        blockStart+=insData[j].size();
+      }
+      blockStart++;
+    }
+
+    for (int i=0; i<chans; i++) {
+      chanStreamOff[i]=w->tell();
+      for (int j: chanIns[i]) {
+        if (j<0) {
+          w->writeC(0xf5);
+          w->writeI(blockOff[-1-j]);
+        } else {
+          w->write(insData[j].c_str(),insData[j].size());
+        }
+      }
+      logI("- %d: off %x size %ld",i,chanStreamOff[i],w->tell()-chanStreamOff[i]);
+    }
+    for (std::vector<int>& i: blocks) {
+      for (int j: i) {
+        w->write(insData[j].c_str(),insData[j].size());
+      }
+      w->writeC(0xf9);
+    }
+    size_t sizeAfter=(chans>0)?(w->size()-chanStreamOff[0]):0;
+    logI("command stream: %d bytes before sub-block extraction, %d after (%.1f%%). %d sub-blocks.",(int)sizeBefore,(int)sizeAfter,sizeBefore?(100.0*(double)sizeAfter/(double)sizeBefore):100.0,(int)blocks.size());
+
     w->seek(8,SEEK_SET);
     for (int i=0; i<chans; i++) {
       w->writeI(chanStreamOff[i]);
@@ -529,6 +794,10 @@ SafeWriter* DivEngine::saveCommand(bool binary) {
     }
   }
 
+  if (binary && exact) {
+    cmdStreamCacheLoops=playing;
+  }
+
   remainingLoops=-1;
   playing=false;
   freelance=false;
@@ -39,6 +39,9 @@
 #include <math.h>
 #include <float.h>
 #include <fmt/printf.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 void process(void* u, float** in, float** out, int inChans, int outChans, unsigned int size) {
   ((DivEngine*)u)->nextBuf(in,out,inChans,outChans,size);
@@ -170,7 +173,7 @@ void DivEngine::walkSong(int& loopOrder, int& loopRow, int& loopEnd) {
   int nextRow=0;
   int effectVal=0;
   int lastSuspectedLoopEnd=-1;
-  DivPattern* pat[DIV_MAX_CHANS];
+  const DivPattern* pat[DIV_MAX_CHANS];
   unsigned char wsWalked[8192];
   memset(wsWalked,0,8192);
   for (int i=0; i<curSubSong->ordersLen; i++) {
@@ -239,6 +242,168 @@ void DivEngine::walkSong(int& loopOrder, int& loopRow, int& loopEnd) {
   }
 }
 
+double DivSongTimestamps::getTime(int order, int row) const {
+  if (order<0 || order>=ordersLen || row<0 || row>=patLen) return -1.0;
+  return rowTime[order*patLen+row];
+}
+
+DivSongTimestamps DivEngine::calcSongTimestamps(int subSong) {
+  DivSongTimestamps ret;
+  if (subSong<0 || subSong>=(int)song.subsong.size()) return ret;
+  DivSubSong* s=song.subsong[subSong];
+  if (s->patLen<1 || s->ordersLen<1) return ret;
+
+  ret.patLen=s->patLen;
+  ret.ordersLen=s->ordersLen;
+  ret.rowTime.resize(ret.patLen*ret.ordersLen,-1.0);
+
+  // this mirrors the tick/row logic in nextTick()/nextRow()/processRowPre(),
+  // but only looks at effects which affect timing.
+  DivGroovePattern walkSpeeds=s->speeds;
+  int walkSpeed=0;
+  int ord=0;
+  int row=0;
+  int ticksLeft=1;
+  int accum=0;
+  int vN=MAX(1,s->virtualTempoN);
+  int vD=MAX(1,s->virtualTempoD);
+  double walkDivider=MAX(1.0,s->hz);
+  bool stopSched=false;
+  double seconds=0.0;
+
+  while (true) {
+    bool newRow=false;
+    accum+=vN;
+    while (accum>=vD) {
+      accum-=vD;
+      if (--ticksLeft<=0) {
+        newRow=true;
+        break;
+      }
+    }
+    if (accum>1023) accum=1023;
+
+    if (newRow) {
+      if (stopSched) break;
+      if (ret.rowTime[ord*ret.patLen+row]>=0.0) {
+        // we've been here before
+        ret.loopOrder=ord;
+        ret.loopRow=row;
+        ret.loopStart=ret.rowTime[ord*ret.patLen+row];
+        break;
+      }
+      ret.rowTime[ord*ret.patLen+row]=seconds;
+
+      int changeOrd=-1;
+      int changePos=0;
+      for (int i=0; i<chans; i++) {
+        const DivPattern* pat=s->pat[i].getPattern(s->orders.ord[i][ord],false);
+        for (int j=0; j<s->pat[i].effectCols; j++) {
+          short effect=pat->data[row][4+(j<<1)];
+          short effectVal=pat->data[row][5+(j<<1)];
+          if (effectVal==-1) effectVal=0;
+          effectVal&=255;
+
+          switch (effect) {
+            case 0x09: // select groove pattern/speed 1
+              if (song.grooves.empty()) {
+                if (effectVal>0) walkSpeeds.val[0]=effectVal;
+              } else {
+                if (effectVal<(short)song.grooves.size()) {
+                  walkSpeeds=song.grooves[effectVal];
+                  walkSpeed=0;
+                }
+              }
+              break;
+            case 0x0f: // speed 1/speed 2
+              if (walkSpeeds.len==2 && song.grooves.empty()) {
+                if (effectVal>0) walkSpeeds.val[1]=effectVal;
+              } else {
+                if (effectVal>0) walkSpeeds.val[0]=effectVal;
+              }
+              break;
+            case 0x0b: // change order
+              if (changeOrd==-1 || song.jumpTreatment==0) {
+                changeOrd=effectVal;
+                if (song.jumpTreatment==1 || song.jumpTreatment==2) {
+                  changePos=0;
+                }
+              }
+              break;
+            case 0x0d: // next order
+              if (ord<(ret.ordersLen-1) || !song.ignoreJumpAtEnd) {
+                if (song.jumpTreatment==2) {
+                  changeOrd=-2;
+                  changePos=effectVal;
+                } else if (song.jumpTreatment==1) {
+                  if (changeOrd<0) {
+                    changeOrd=-2;
+                    changePos=effectVal;
+                  }
+                } else {
+                  if (changeOrd<0) {
+                    changeOrd=-2;
+                  }
+                  changePos=effectVal;
+                }
+              }
+              break;
+            case 0xc0: case 0xc1: case 0xc2: case 0xc3: // set Hz
+              walkDivider=(double)(((effect&0x3)<<8)|effectVal);
+              if (walkDivider<1) walkDivider=1;
+              break;
+            case 0xf0: // set Hz by tempo
+              walkDivider=(double)effectVal*2.0/5.0;
+              if (walkDivider<1) walkDivider=1;
+              break;
+            case 0xff: // stop song
+              stopSched=true;
+              break;
+          }
+        }
+      }
+
+      // advance
+      if (changeOrd!=-1) {
+        row=changePos;
+        if (changeOrd==-2) changeOrd=ord+1;
+        ord=changeOrd;
+        if (ord>=ret.ordersLen) ord=0;
+      } else if (++row>=ret.patLen) {
+        if (stopSched) {
+          row=ret.patLen-1;
+        } else {
+          row=0;
+          if (++ord>=ret.ordersLen) ord=0;
+        }
+      }
+      if (row>=ret.patLen) {
+        row=0;
+        if (++ord>=ret.ordersLen) ord=0;
+      }
+
+      // row length
+      if (song.brokenSpeedSel) {
+        unsigned char speed2=(walkSpeeds.len>=2)?walkSpeeds.val[1]:walkSpeeds.val[0];
+        unsigned char speed1=walkSpeeds.val[0];
+        if ((ret.patLen&1) && ord&1) {
+          ticksLeft=((row&1)?speed2:speed1)*(s->timeBase+1);
+        } else {
+          ticksLeft=((row&1)?speed1:speed2)*(s->timeBase+1);
+        }
+      } else {
+        ticksLeft=walkSpeeds.val[walkSpeed]*(s->timeBase+1);
+        if (++walkSpeed>=walkSpeeds.len) walkSpeed=0;
+      }
+    }
+
+    seconds+=1.0/walkDivider;
+    ret.totalTicks++;
+  }
+  ret.totalSeconds=seconds;
+  return ret;
+}
+
 #define EXPORT_BUFSIZE 2048
 
 double DivEngine::benchmarkPlayback() {
@@ -296,6 +461,48 @@ double DivEngine::benchmarkSeek() {
   return tAvg;
 }
 
+double DivEngine::benchmarkCommandStream() {
+  SafeWriter* w=saveCommand(true);
+  if (w==NULL) {
+    logE("could not export command stream!");
+    return 0.0;
+  }
+  size_t len=w->size();
+  unsigned char* buf=new unsigned char[len];
+  memcpy(buf,w->getFinalBuf(),len);
+  w->finish();
+  delete w;
+
+  DivCSPlayer* player=new DivCSPlayer(this,buf,len);
+  if (!player->init()) {
+    logE("not a command stream!");
+    player->cleanup();
+    delete player;
+    return 0.0;
+  }
+
+  BUSY_BEGIN;
+  reset();
+  int tickCount=0;
+
+  std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
+
+  // benchmark
+  while (player->tick()) {
+    tickCount++;
+  }
+
+  std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
+  BUSY_END;
+
+  player->cleanup();
+  delete player;
+
+  double t=(double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
+  printf("[RESULT] %d bytes, %d ticks, %fs (%fus per tick)\n",(int)len,tickCount,t,(tickCount>0)?(t*1000000.0/(double)tickCount):0.0);
+  return t;
+}
+
 void DivEngine::notifyInsChange(int ins) {
   BUSY_BEGIN;
   for (int i=0; i<song.systemLen; i++) {
@@ -312,8 +519,8 @@ void DivEngine::notifyWaveChange(int wave) {
   BUSY_END;
 }
 
-int DivEngine::loadSampleROM(String path, ssize_t expectedSize, unsigned char*& ret) {
-  ret=NULL;
+int DivEngine::loadSampleROM(String path, ssize_t expectedSize, DivSampleROM& ret) {
+  freeSampleROM(ret);
   if (path.empty()) {
     return 0;
   }
@@ -351,8 +558,21 @@ int DivEngine::loadSampleROM(String path, ssize_t expectedSize, unsigned char*&
   if (len!=expectedSize) {
     logE("ROM size mismatch, expected: %d bytes, was: %d bytes", expectedSize, len);
     lastError=fmt::sprintf("ROM size mismatch, expected: %d bytes, was: %d", expectedSize, len);
+    fclose(f);
     return -1;
   }
+#ifndef _WIN32
+  // map the file instead of reading it. pages are only loaded when used.
+  void* mapped=mmap(NULL,(size_t)len,PROT_READ,MAP_PRIVATE,fileno(f),0);
+  if (mapped!=MAP_FAILED) {
+    fclose(f);
+    ret.data=(unsigned char*)mapped;
+    ret.len=len;
+    ret.mapped=true;
+    return 0;
+  }
+  logW("could not map ROM (%s). reading it instead.",strerror(errno));
+#endif
   if (fseek(f,0,SEEK_SET)<0) {
     logE("size error: %s",strerror(errno));
     lastError=fmt::sprintf("on get size: %s",strerror(errno));
@@ -368,10 +588,28 @@ int DivEngine::loadSampleROM(String path, ssize_t expectedSize, unsigned char*&
     return -1;
   }
   fclose(f);
-  ret=file;
+  ret.data=file;
+  ret.len=len;
+  ret.mapped=false;
   return 0;
 }
 
+void DivEngine::freeSampleROM(DivSampleROM& rom) {
+  if (rom.data==NULL) return;
+#ifndef _WIN32
+  if (rom.mapped) {
+    munmap(rom.data,rom.len);
+  } else {
+    delete[] rom.data;
+  }
+#else
+  delete[] rom.data;
+#endif
+  rom.data=NULL;
+  rom.len=0;
+  rom.mapped=false;
+}
+
 unsigned int DivEngine::getSampleFormatMask() {
   unsigned int formatMask=1U<<16; // 16-bit is always on
   for (int i=0; i<song.systemLen; i++) {
@@ -383,18 +621,9 @@ unsigned int DivEngine::getSampleFormatMask() {
 }
 
 int DivEngine::loadSampleROMs() {
-  if (yrw801ROM!=NULL) {
-    delete[] yrw801ROM;
-    yrw801ROM=NULL;
-  }
-  if (tg100ROM!=NULL) {
-    delete[] tg100ROM;
-    tg100ROM=NULL;
-  }
-  if (mu5ROM!=NULL) {
-    delete[] mu5ROM;
-    mu5ROM=NULL;
-  }
+  freeSampleROM(yrw801ROM);
+  freeSampleROM(tg100ROM);
+  freeSampleROM(mu5ROM);
   int error=0;
   error+=loadSampleROM(getConfString("yrw801Path",""), 0x200000, yrw801ROM);
   error+=loadSampleROM(getConfString("tg100Path",""), 0x200000, tg100ROM);
@@ -424,15 +653,51 @@ void DivEngine::renderSamples(int whichSample) {
   }
 
   // step 1: render samples
+  // formats which are already up to date are skipped by DivSample::render().
   if (whichSample==-1) {
-    for (int i=0; i<song.sampleLen; i++) {
-      song.sample[i]->render(formatMask);
+    if (renderPoolThreads>1 && song.sampleLen>1) {
+      struct SampleRenderJob {
+        DivSample* sample;
+        unsigned int formatMask;
+      };
+      std::vector<SampleRenderJob> jobs;
+      jobs.reserve(song.sampleLen);
+      for (int i=0; i<song.sampleLen; i++) {
+        jobs.push_back(SampleRenderJob{song.sample[i],formatMask});
+      }
+      DivWorkPool* samplePool=new DivWorkPool(MIN(renderPoolThreads,(unsigned int)song.sampleLen));
+      for (SampleRenderJob& i: jobs) {
+        samplePool->push([](void* d) {
+          SampleRenderJob* job=(SampleRenderJob*)d;
+          job->sample->render(job->formatMask);
+        },&i);
+      }
+      samplePool->wait();
+      delete samplePool;
+    } else {
+      for (int i=0; i<song.sampleLen; i++) {
+        song.sample[i]->render(formatMask);
+      }
     }
   } else if (whichSample>=0 && whichSample<song.sampleLen) {
     song.sample[whichSample]->render(formatMask);
   }
 
-  // step 2: render samples to dispatch
+  // step 2: free converted data which no chip needs once it exceeds the budget
+  if (sampleFormatBudget>0) {
+    size_t unusedSize=0;
+    for (int i=0; i<song.sampleLen; i++) {
+      unusedSize+=song.sample[i]->freeUnusedFormats(formatMask,true);
+    }
+    if (unusedSize>((size_t)sampleFormatBudget<<20)) {
+      logD("freeing %d bytes of unused sample data",(int)unusedSize);
+      for (int i=0; i<song.sampleLen; i++) {
+        song.sample[i]->freeUnusedFormats(formatMask);
+      }
+    }
+  }
+
+  // step 3: render samples to dispatch
   for (int i=0; i<song.systemLen; i++) {
     if (disCont[i].dispatch!=NULL) {
       disCont[i].dispatch->renderSamples(i);
@@ -671,6 +936,9 @@ void DivEngine::changeSong(size_t songIndex) {
   curRow=0;
   prevOrder=0;
   prevRow=0;
+  cmdStreamCacheValid=false;
+  songRev++;
+  vgmCache.clear();
 }
 
 void DivEngine::moveAsset(std::vector<DivAssetDir>& dir, int before, int after) {
@@ -814,7 +1082,7 @@ int DivEngine::duplicateSubSong(int index) {
 
     for (int j=0; j<DIV_MAX_PATTERNS; j++) {
       if (theOrig->pat[i].data[j]==NULL) continue;
-      DivPattern* origPat=theOrig->pat[i].getPattern(j,false);
+      const DivPattern* origPat=theOrig->pat[i].getPattern(j,false);
       DivPattern* copyPat=theCopy->pat[i].getPattern(j,true);
       origPat->copyOn(copyPat);
     }
@@ -901,10 +1169,11 @@ void DivEngine::delUnusedIns() {
   for (int i=0; i<chans; i++) {
     for (size_t j=0; j<song.subsong.size(); j++) {
       for (int k=0; k<DIV_MAX_PATTERNS; k++) {
-        if (song.subsong[j]->pat[i].data[k]==NULL) continue;
+        const DivPattern* pat=song.subsong[j]->pat[i].data[k];
+        if (pat==NULL) continue;
         for (int l=0; l<song.subsong[j]->patLen; l++) {
-          if (song.subsong[j]->pat[i].data[k]->data[l][2]>=0 && song.subsong[j]->pat[i].data[k]->data[l][2]<256) {
-            isUsed[song.subsong[j]->pat[i].data[k]->data[l][2]]=true;
+          if (pat->data[l][2]>=0 && pat->data[l][2]<256) {
+            isUsed[pat->data[l][2]]=true;
           }
         }
       }
@@ -1442,6 +1711,58 @@ unsigned char* DivEngine::getRegisterPool(int sys, int& size, int& depth) {
   return disCont[sys].dispatch->getRegisterPool();
 }
 
+void DivEngine::captureDebugSnapshot() {
+  DivDebugSnapshot& snap=debugSnap[debugSnapBack];
+
+  snap.systemLen=song.systemLen;
+  for (int i=0; i<song.systemLen; i++) {
+    snap.regPool[i]=NULL;
+    if (disCont[i].dispatch==NULL) continue;
+    unsigned char* regPool=disCont[i].dispatch->getRegisterPool();
+    if (regPool==NULL) continue;
+    int size=disCont[i].dispatch->getRegisterPoolSize();
+    int depth=disCont[i].dispatch->getRegisterPoolDepth();
+    size_t len=size*((depth+7)>>3);
+    // not sized yet (chips changed). skip until a snapshot with enough room comes around
+    if (snap.regPoolData[i].size()<len) continue;
+    memcpy(snap.regPoolData[i].data(),regPool,len);
+    snap.regPool[i]=snap.regPoolData[i].data();
+    snap.regPoolSize[i]=size;
+    snap.regPoolDepth[i]=depth;
+  }
+
+  snap.chans=chans;
+  for (int i=0; i<chans; i++) {
+    snap.chan[i].set(chan[i]);
+  }
+
+  // publish
+  debugSnapBack=debugSnapShared.exchange(debugSnapBack|DIV_DEBUG_SNAP_FRESH)&3;
+}
+
+void DivEngine::sizeDebugSnapshot(DivDebugSnapshot& snap) {
+  for (int i=0; i<song.systemLen; i++) {
+    if (disCont[i].dispatch==NULL) continue;
+    if (disCont[i].dispatch->getRegisterPool()==NULL) continue;
+    int size=disCont[i].dispatch->getRegisterPoolSize();
+    int depth=disCont[i].dispatch->getRegisterPoolDepth();
+    size_t len=size*((depth+7)>>3);
+    if (snap.regPoolData[i].size()<len) snap.regPoolData[i].resize(len);
+  }
+}
+
+const DivDebugSnapshot* DivEngine::getDebugSnapshot() {
+  debugSnapWanted=true;
+  if (debugSnapShared.load()&DIV_DEBUG_SNAP_FRESH) {
+    // the front buffer goes back to the audio thread
+    sizeDebugSnapshot(debugSnap[debugSnapFront]);
+    debugSnapFront=debugSnapShared.exchange(debugSnapFront)&3;
+    debugSnapValid=true;
+  }
+  if (!debugSnapValid) return NULL;
+  return &debugSnap[debugSnapFront];
+}
+
 DivMacroInt* DivEngine::getMacroInt(int chan) {
   if (chan<0 || chan>=chans) return NULL;
   return disCont[dispatchOfChan[chan]].dispatch->getChanMacroInt(dispatchChanOfChan[chan]);
@@ -1476,6 +1797,10 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
   logV("playSub() called");
   std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(false);
+  // seeking or editing orders during precompiled playback continues from patterns
+  if (cmdStreamSong) {
+    stopCommandStream();
+  }
   reset();
   if (preserveDrift && curOrder==0) {
     logV("preserveDrift && curOrder is true");
@@ -1732,6 +2057,18 @@ unsigned int DivEngine::convertPanLinearToSplit(int val, unsigned char bits, int
 }
 
 bool DivEngine::play() {
+  if (precompiledPlayback) {
+    // only recompiles if the song changed since the last time
+    if (!compileCommandStream()) return false;
+    BUSY_BEGIN_SOFT;
+    sPreview.sample=-1;
+    sPreview.wave=-1;
+    sPreview.pos=0;
+    sPreview.dir=false;
+    bool ret=startCommandStream();
+    BUSY_END;
+    return ret;
+  }
   BUSY_BEGIN_SOFT;
   curOrder=prevOrder;
   sPreview.sample=-1;
@@ -1860,6 +2197,9 @@ void DivEngine::stepOne(int row) {
 void DivEngine::stop() {
   BUSY_BEGIN;
   freelance=false;
+  if (cmdStreamSong) {
+    stopCommandStream();
+  }
   if (!playing) {
     //Send midi panic
     if (output) if (output->midiOut!=NULL) {
@@ -2356,11 +2696,19 @@ void DivEngine::dumpSongInfo() {
   printf("SUB-SONGS\n");
   int index=0;
   for (DivSubSong* i: song.subsong) {
+    DivSongTimestamps ts=calcSongTimestamps(index);
     printf(
-      "=== %d: %s\n"
-      "<<<\n%s\n>>>\n",
+      "=== %d: %s\n",
       index,
-      i->name.c_str(),
+      i->name.c_str()
+    );
+    if (ts.loopOrder<0) {
+      printf("- length: %d:%05.2f (stops)\n",(int)(ts.totalSeconds/60.0),fmod(ts.totalSeconds,60.0));
+    } else {
+      printf("- length: %d:%05.2f (loops to %.2x/%d at %d:%05.2f)\n",(int)(ts.totalSeconds/60.0),fmod(ts.totalSeconds,60.0),ts.loopOrder,ts.loopRow,(int)(ts.loopStart/60.0),fmod(ts.loopStart,60.0));
+    }
+    printf(
+      "<<<\n%s\n>>>\n",
       i->notes.c_str()
     );
     index++;
@@ -2475,10 +2823,13 @@ void DivEngine::delInstrumentUnsafe(int index) {
     for (int i=0; i<chans; i++) {
       for (size_t j=0; j<song.subsong.size(); j++) {
         for (int k=0; k<DIV_MAX_PATTERNS; k++) {
-          if (song.subsong[j]->pat[i].data[k]==NULL) continue;
+          DivPattern* pat=song.subsong[j]->pat[i].data[k];
+          if (pat==NULL) continue;
+          // read through const so that empty rows aren't allocated
+          const DivPatternData& data=pat->data;
           for (int l=0; l<song.subsong[j]->patLen; l++) {
-            if (song.subsong[j]->pat[i].data[k]->data[l][2]>index) {
-              song.subsong[j]->pat[i].data[k]->data[l][2]--;
+            if (data[l][2]>index) {
+              pat->data[l][2]--;
             }
           }
         }
@@ -2836,9 +3187,9 @@ void DivEngine::deepCloneOrder(int pos, bool where) {
       if (curPat[i].data[j]==NULL) {
         int origOrd=order[i];
         order[i]=j;
-        DivPattern* oldPat=curPat[i].getPattern(origOrd,false);
+        const DivPattern* oldPat=curPat[i].getPattern(origOrd,false);
         DivPattern* pat=curPat[i].getPattern(j,true);
-        memcpy(pat->data,oldPat->data,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
+        pat->data=oldPat->data;
         logD("found at %d",j);
         didNotFind=false;
         break;
@@ -2942,12 +3293,15 @@ void DivEngine::exchangeIns(int one, int two) {
   for (int i=0; i<chans; i++) {
     for (size_t j=0; j<song.subsong.size(); j++) {
       for (int k=0; k<DIV_MAX_PATTERNS; k++) {
-        if (song.subsong[j]->pat[i].data[k]==NULL) continue;
+        DivPattern* pat=song.subsong[j]->pat[i].data[k];
+        if (pat==NULL) continue;
+        // read through const so that empty rows aren't allocated
+        const DivPatternData& data=pat->data;
         for (int l=0; l<song.subsong[j]->patLen; l++) {
-          if (song.subsong[j]->pat[i].data[k]->data[l][2]==one) {
-            song.subsong[j]->pat[i].data[k]->data[l][2]=two;
-          } else if (song.subsong[j]->pat[i].data[k]->data[l][2]==two) {
-            song.subsong[j]->pat[i].data[k]->data[l][2]=one;
+          if (data[l][2]==one) {
+            pat->data[l][2]=two;
+          } else if (data[l][2]==two) {
+            pat->data[l][2]=one;
           }
         }
       }
@@ -3364,6 +3718,10 @@ void DivEngine::setConsoleMode(bool enable) {
   consoleMode=enable;
 }
 
+void DivEngine::setLowLatency(bool enable) {
+  lowLatency=enable;
+}
+
 bool DivEngine::switchMaster(bool full) {
   logI("switching output...");
   deinitAudioBackend(true);
@@ -3510,6 +3868,8 @@ void DivEngine::initDispatch(bool isRender) {
     saveLock.unlock();
   }
   recalcChans();
+  // the audio thread only captures while holding isBusy
+  sizeDebugSnapshot(debugSnap[debugSnapBack]);
   BUSY_END;
 }
 
@@ -3584,6 +3944,7 @@ bool DivEngine::initAudioBackend() {
   forceMono=getConfInt("forceMono",0);
   clampSamples=getConfInt("clampSamples",0);
   lowLatency=getConfInt("lowLatency",0);
+  precompiledPlayback=getConfInt("precompiledPlayback",0);
   metroVol=(float)(getConfInt("metroVol",100))/100.0f;
   previewVol=(float)(getConfInt("sampleVol",50))/100.0f;
   midiOutClock=getConfInt("midiOutClock",0);
@@ -3596,8 +3957,11 @@ bool DivEngine::initAudioBackend() {
   if (previewVol<0.0f) previewVol=0.0f;
   if (previewVol>1.0f) previewVol=1.0f;
   renderPoolThreads=getConfInt("renderPoolThreads",0);
+  sampleFormatBudget=getConfInt("sampleFormatBudget",0);
+  if (sampleFormatBudget<0) sampleFormatBudget=0;
 
   if (lowLatency) logI("using low latency mode.");
+  if (precompiledPlayback) logI("using precompiled playback.");
 
   switch (audioEngine) {
     case DIV_AUDIO_JACK:
@@ -3900,9 +4264,15 @@ bool DivEngine::quit() {
     metroBuf=NULL;
     metroBufLen=0;
   }
-  if (yrw801ROM!=NULL) delete[] yrw801ROM;
-  if (tg100ROM!=NULL) delete[] tg100ROM;
-  if (mu5ROM!=NULL) delete[] mu5ROM;
+  if (cmdStreamCache!=NULL) {
+    delete[] cmdStreamCache;
+    cmdStreamCache=NULL;
+    cmdStreamCacheLen=0;
+  }
+  freeSampleROM(yrw801ROM);
+  freeSampleROM(tg100ROM);
+  freeSampleROM(mu5ROM);
+  vgmCache.clear();
   song.unload();
   return true;
 }
@@ -33,6 +33,7 @@
 #include <functional>
 #include <initializer_list>
 #include <thread>
+#include <chrono>
 #include "../fixedQueue.h"
 
 class DivWorkPool;
@@ -52,6 +53,8 @@ class DivWorkPool;
 #define EXTERN_BUSY_BEGIN_SOFT e->softLocked=true; e->isBusy.lock();
 #define EXTERN_BUSY_END e->isBusy.unlock(); e->softLocked=false;
 
+#define DIV_DEBUG_SNAP_FRESH 4
+
 //#define DIV_UNSTABLE
 
 #define DIV_VERSION "0.6.1"
@@ -172,6 +175,49 @@ struct DivChannelState {
     midiAftertouch(false) {}
 };
 
+// the parts of DivChannelState shown in the debug window.
+struct DivChannelSummary {
+  int note, oldNote, pitch, portaSpeed, portaNote;
+  int volume, volSpeed, cut, rowDelay, volMax;
+  int delayOrder, delayRow, retrigSpeed, retrigTick;
+  int vibratoDepth, vibratoRate, vibratoPos, vibratoDir, vibratoFine;
+  int tremoloDepth, tremoloRate, tremoloPos;
+  unsigned char arp, arpStage, arpTicks;
+  bool doNote, legato, portaStop, keyOn, keyOff, nowYouCanStop, stopOnOff;
+  bool arpYield, delayLocked, inPorta, scheduledSlideReset;
+
+  void set(const DivChannelState& s) {
+    note=s.note; oldNote=s.oldNote; pitch=s.pitch; portaSpeed=s.portaSpeed; portaNote=s.portaNote;
+    volume=s.volume; volSpeed=s.volSpeed; cut=s.cut; rowDelay=s.rowDelay; volMax=s.volMax;
+    delayOrder=s.delayOrder; delayRow=s.delayRow; retrigSpeed=s.retrigSpeed; retrigTick=s.retrigTick;
+    vibratoDepth=s.vibratoDepth; vibratoRate=s.vibratoRate; vibratoPos=s.vibratoPos; vibratoDir=s.vibratoDir; vibratoFine=s.vibratoFine;
+    tremoloDepth=s.tremoloDepth; tremoloRate=s.tremoloRate; tremoloPos=s.tremoloPos;
+    arp=s.arp; arpStage=s.arpStage; arpTicks=s.arpTicks;
+    doNote=s.doNote; legato=s.legato; portaStop=s.portaStop; keyOn=s.keyOn; keyOff=s.keyOff; nowYouCanStop=s.nowYouCanStop; stopOnOff=s.stopOnOff;
+    arpYield=s.arpYield; delayLocked=s.delayLocked; inPorta=s.inPorta; scheduledSlideReset=s.scheduledSlideReset;
+  }
+};
+
+// register pools and channel states, as captured by the audio thread at the
+// end of a buffer for the register view and debug window.
+struct DivDebugSnapshot {
+  int systemLen, chans;
+  int regPoolSize[DIV_MAX_CHIPS];
+  int regPoolDepth[DIV_MAX_CHIPS];
+  // NULL if the chip has no register pool
+  unsigned char* regPool[DIV_MAX_CHIPS];
+  std::vector<unsigned char> regPoolData[DIV_MAX_CHIPS];
+  DivChannelSummary chan[DIV_MAX_CHANS];
+
+  DivDebugSnapshot():
+    systemLen(0),
+    chans(0) {
+    memset(regPoolSize,0,DIV_MAX_CHIPS*sizeof(int));
+    memset(regPoolDepth,0,DIV_MAX_CHIPS*sizeof(int));
+    memset(regPool,0,DIV_MAX_CHIPS*sizeof(unsigned char*));
+  }
+};
+
 struct DivNoteEvent {
   signed char channel;
   short ins;
@@ -262,6 +308,44 @@ struct DivEffectContainer {
   }
 };
 
+// the result of the last VGM export, along with the song revision and export
+// parameters that produced it.
+struct DivVGMExportCache {
+  unsigned int songRev;
+  String params;
+  SafeWriter* data;
+  String warnings;
+
+  void clear();
+  DivVGMExportCache():
+    songRev(0),
+    data(NULL) {}
+};
+
+// timing of a sub-song, found by walking its patterns without playing it.
+struct DivSongTimestamps {
+  // time in seconds at which each row is first reached, indexed by
+  // order*patLen+row. -1 if the row is never reached.
+  std::vector<double> rowTime;
+  int patLen, ordersLen;
+  // length of one pass through the song (up to the loop or stop point)
+  double totalSeconds;
+  int totalTicks;
+  // loop point. loopOrder is -1 if the song stops.
+  int loopOrder, loopRow;
+  double loopStart;
+
+  double getTime(int order, int row) const;
+  DivSongTimestamps():
+    patLen(0),
+    ordersLen(0),
+    totalSeconds(0.0),
+    totalTicks(0),
+    loopOrder(-1),
+    loopRow(0),
+    loopStart(0.0) {}
+};
+
 typedef int EffectValConversion(unsigned char,unsigned char);
 
 struct EffectHandler {
@@ -281,6 +365,30 @@ struct EffectHandler {
   val2(val2_) {}
 };
 
+struct DivSampleROM {
+  unsigned char* data;
+  size_t len;
+  // whether data is a read-only mapping of the file rather than a heap buffer
+  bool mapped;
+  DivSampleROM():
+    data(NULL),
+    len(0),
+    mapped(false) {}
+};
+
+// a range of a .fur file which is compressed on its own in the chunked container.
+// id is "HEAD" (song info, instruments and wavetables), "SMP2" (a sample) or "PATS" (the patterns of a sub-song).
+struct DivFurChunk {
+  char id[4];
+  unsigned int index, offset, len;
+  DivFurChunk(const char* i, unsigned int x, unsigned int o):
+    index(x),
+    offset(o),
+    len(0) {
+    memcpy(id,i,4);
+  }
+};
+
 struct DivDoNotHandleEffect {
 };
 
@@ -417,6 +525,8 @@ class DivEngine {
   bool midiIsDirect;
   bool midiIsDirectProgram;
   bool lowLatency;
+  bool precompiledPlayback;
+  bool cmdStreamSong;
   bool systemsRegistered;
   bool hasLoadedSomething;
   bool midiOutClock;
@@ -469,6 +579,21 @@ class DivEngine {
   static DivSystem sysFileMapDMF[DIV_MAX_CHIP_DEFS];
 
   DivCSPlayer* cmdStreamInt;
+  unsigned char* cmdStreamCache;
+  size_t cmdStreamCacheLen;
+  size_t cmdStreamCacheSubSong;
+  bool cmdStreamCacheValid;
+  // whether the compiled song loops (as opposed to stopping)
+  bool cmdStreamCacheLoops;
+  // tick on which the compiled song loops, and the current tick
+  int cmdStreamCacheLoopTick, cmdStreamTick;
+  // bumped whenever the song is modified or changed
+  unsigned int songRev;
+  bool exportFromStream;
+  double exportLength;
+  int exportFileCur, exportFileCount;
+  std::chrono::steady_clock::time_point exportStartTime;
+  DivVGMExportCache vgmCache;
 
   struct SamplePreview {
     double rate;
@@ -490,6 +615,20 @@ class DivEngine {
       dir(false) {}
   } sPreview;
 
+  // pattern playback state right before the loop of the precompiled song.
+  // playback continues from patterns at that point.
+  struct CmdStreamLoopState {
+    DivChannelState chan[DIV_MAX_CHANS];
+    DivGroovePattern speeds;
+    unsigned char walked[8192];
+    int subticks, ticks, curRow, curOrder, prevRow, prevOrder, nextSpeed, elapsedBars, elapsedBeats, curSpeed;
+    int stepPlay, changeOrd, changePos, globalPitch;
+    double divider;
+    short tempoAccum;
+    unsigned char extValue, arpLen;
+    bool extValuePresent, endOfSong, shallStopSched;
+  } cmdStreamLoop;
+
   short vibTable[64];
   short tremTable[128];
   int reversePitchTable[4096];
@@ -517,15 +656,32 @@ class DivEngine {
   size_t totalProcessed;
 
   unsigned int renderPoolThreads;
+  // memory (in MB) which converted sample data no chip needs may use before it is freed. 0 means no limit.
+  int sampleFormatBudget;
   DivWorkPool* renderPool;
 
+  // debug snapshots are passed from the audio thread to the GUI through a
+  // triple buffer. debugSnapShared holds the index of the buffer in the
+  // middle, plus DIV_DEBUG_SNAP_FRESH if it has not been picked up yet.
+  DivDebugSnapshot debugSnap[3];
+  std::atomic<unsigned char> debugSnapShared;
+  unsigned char debugSnapBack, debugSnapFront;
+  std::atomic<bool> debugSnapWanted;
+  bool debugSnapValid;
+
   // MIDI stuff
   std::function<int(const TAMidiMessage&)> midiCallback=[](const TAMidiMessage&) -> int {return -2;};
 
   void processRowPre(int i);
+  // capture a debug snapshot and publish it (audio thread)
+  void captureDebugSnapshot();
+  // make room for the register pools of the current chips in a snapshot, so that capturing
+  // it doesn't allocate. only call on a snapshot the audio thread can't be using.
+  void sizeDebugSnapshot(DivDebugSnapshot& snap);
   void processRow(int i, bool afterDelay);
   void nextOrder();
   void nextRow();
+  String getVGMExportKey(bool* sysToExport, bool loop, int version, bool patternHints, bool directStream, int trailingTicks);
   void performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write, int streamOff, double* loopTimer, double* loopFreq, int* loopSample, bool* sampleDir, bool isSecond, int* pendingFreq, int* playingSample, int* setPos, unsigned int* sampleOff8, unsigned int* sampleLen8, size_t bankOffset, bool directStream);
   // returns true if end of song.
   bool nextTick(bool noAccum=false, bool inhibitLowLat=false);
@@ -535,6 +691,19 @@ class DivEngine {
   void recalcChans();
   void reset();
   void playSub(bool preserveDrift, int goalRow=0);
+  // compile the current song to a binary command stream if the cached one is out of date.
+  // returns false on failure.
+  bool compileCommandStream();
+  // start playing the compiled command stream (UNSAFE).
+  bool startCommandStream();
+  // stop playing a command stream compiled from the song (UNSAFE).
+  void stopCommandStream();
+  // save the pattern playback state before the loop tick while compiling, and restore it
+  // when the precompiled song reaches that tick (UNSAFE).
+  void storeCommandStreamLoop();
+  void restoreCommandStreamLoop();
+  // start playback for audio export
+  void exportPlaySub();
   void runMidiClock(int totalCycles=1);
   void runMidiTime(int totalCycles=1);
   bool shallSwitchCores();
@@ -542,7 +711,8 @@ class DivEngine {
   void testFunction();
 
   bool loadDMF(unsigned char* file, size_t len);
-  bool loadFur(unsigned char* file, size_t len);
+  bool loadFur(unsigned char* file, size_t len, bool metadataOnly=false);
+  bool unpackFurChunks(unsigned char* f, size_t slen, unsigned char*& file, size_t& len, bool metadataOnly);
   bool loadMod(unsigned char* file, size_t len);
   bool loadS3M(unsigned char* file, size_t len);
   bool loadFTM(unsigned char* file, size_t len);
@@ -563,7 +733,8 @@ class DivEngine {
   void loadWOPL(SafeReader& reader, std::vector<DivInstrument*>& ret, String& stripPath);
   void loadWOPN(SafeReader& reader, std::vector<DivInstrument*>& ret, String& stripPath);
 
-  int loadSampleROM(String path, ssize_t expectedSize, unsigned char*& ret);
+  int loadSampleROM(String path, ssize_t expectedSize, DivSampleROM& ret);
+  void freeSampleROM(DivSampleROM& rom);
 
   bool initAudioBackend();
   bool deinitAudioBackend(bool dueToSwitchMaster=false);
@@ -597,6 +768,7 @@ class DivEngine {
   // add every export method here
   friend class DivROMExport;
   friend class DivExportAmigaValidation;
+  friend class DivCSPlayer;
 
   public:
     DivSong song;
@@ -628,14 +800,22 @@ class DivEngine {
     void createNew(const char* description, String sysName, bool inBase64=true);
     void createNewFromDefaults();
     // load a file.
-    bool load(unsigned char* f, size_t length);
+    // if metadataOnly is true, sample data may not be read (only in chunked .fur files).
+    bool load(unsigned char* f, size_t length, bool metadataOnly=false);
     // play a binary command stream.
     bool playStream(unsigned char* f, size_t length);
     // save as .dmf.
     SafeWriter* saveDMF(unsigned char version);
     // save as .fur.
     // if notPrimary is true then the song will not be altered
-    SafeWriter* saveFur(bool notPrimary=false, bool newPatternFormat=true);
+    // if chunks is not NULL, it is filled with the ranges to be compressed separately.
+    SafeWriter* saveFur(bool notPrimary=false, bool newPatternFormat=true, std::vector<DivFurChunk>* chunks=NULL);
+    // save as .fur in the chunked container, where every sample and sub-song is compressed on its own.
+    // the result is already compressed.
+    SafeWriter* saveFurChunked(bool newPatternFormat=true);
+    // compress data to a zlib stream.
+    // with multi-threading enabled, blocks are compressed in parallel. returns NULL on error.
+    SafeWriter* compressFile(const unsigned char* data, size_t len);
     // build a ROM file (TODO).
     // specify system to build ROM for.
     std::vector<DivROMExportOutput> buildROM(DivROMExportOptions sys);
@@ -645,11 +825,14 @@ class DivEngine {
     // - x to add x+1 ticks of trailing
     // - -1 to auto-determine trailing
     // - -2 to add a whole loop of trailing
+    // if nothing changed since the last export, the previous result is returned.
     SafeWriter* saveVGM(bool* sysToExport=NULL, bool loop=true, int version=0x171, bool patternHints=false, bool directStream=false, int trailingTicks=-1);
     // dump to ZSM.
     SafeWriter* saveZSM(unsigned int zsmrate=60, bool loop=true, bool optimize=true);
     // dump command stream.
-    SafeWriter* saveCommand(bool binary=false);
+    // if exact is true (binary only), every command sent to the dispatches is stored verbatim instead of hints.
+    // this is used by precompiled playback, which must sound identical to pattern playback.
+    SafeWriter* saveCommand(bool binary=false, bool exact=false);
     // export to text
     SafeWriter* saveText(bool separatePatterns=true);
     // export to an audio file
@@ -683,6 +866,8 @@ class DivEngine {
     // benchmark (returns time in seconds)
     double benchmarkPlayback();
     double benchmarkSeek();
+    // decode cost of the binary command stream
+    double benchmarkCommandStream();
 
     // returns the minimum VGM version which may carry the specified system, or 0 if none.
     int minVGMVersion(DivSystem which);
@@ -737,9 +922,21 @@ class DivEngine {
     // find song loop position
     void walkSong(int& loopOrder, int& loopRow, int& loopEnd);
 
+    // calculate the timing of every row of a sub-song without playing it
+    DivSongTimestamps calcSongTimestamps(int subSong);
+
     // play (returns whether successful)
     bool play();
 
+    // set whether songs are played from a precompiled command stream rather than patterns
+    void setPrecompiledPlayback(bool enable);
+
+    // get whether precompiled playback is enabled
+    bool getPrecompiledPlayback();
+
+    // mark the precompiled command stream and the last VGM export as out of date. call after modifying the song.
+    void invalidateCommandStream();
+
     // play to row (returns whether successful)
     bool playToRow(int row);
 
@@ -915,6 +1112,10 @@ class DivEngine {
     // is exporting
     bool isExporting();
 
+    // get export progress (0 to 1) and estimated time left in seconds.
+    // returns false if the progress is not known.
+    bool getExportProgress(double& progress, double& eta);
+
     // add instrument
     int addInstrument(int refChan=0, DivInstrumentType fallbackType=DIV_INS_STD);
 
@@ -1042,6 +1243,14 @@ class DivEngine {
     // get register pool
     unsigned char* getRegisterPool(int sys, int& size, int& depth);
 
+    /**
+     * get the latest register pool/channel state snapshot published by the
+     * audio thread, and ask it for a new one at the end of the next buffer.
+     * only call this from one thread (the GUI).
+     * @return the snapshot, or NULL if none has been published yet.
+     */
+    const DivDebugSnapshot* getDebugSnapshot();
+
     // get macro interpreter
     DivMacroInt* getMacroInt(int chan);
 
@@ -1084,6 +1293,9 @@ class DivEngine {
     // set the console mode.
     void setConsoleMode(bool enable);
 
+    // set low-latency mode (overrides the setting until the audio backend is initialized again)
+    void setLowLatency(bool enable);
+
     // get metronome
     bool getMetronome();
 
@@ -1245,9 +1457,9 @@ class DivEngine {
     // terminate the engine.
     bool quit();
 
-    unsigned char* yrw801ROM;
-    unsigned char* tg100ROM;
-    unsigned char* mu5ROM;
+    DivSampleROM yrw801ROM;
+    DivSampleROM tg100ROM;
+    DivSampleROM mu5ROM;
 
     DivEngine():
       output(NULL),
@@ -1276,6 +1488,8 @@ class DivEngine {
       midiIsDirect(false),
       midiIsDirectProgram(false),
       lowLatency(false),
+      precompiledPlayback(false),
+      cmdStreamSong(false),
       systemsRegistered(false),
       hasLoadedSomething(false),
       midiOutClock(false),
@@ -1331,6 +1545,18 @@ class DivEngine {
       exportMode(DIV_EXPORT_MODE_ONE),
       exportFadeOut(0.0),
       cmdStreamInt(NULL),
+      cmdStreamCache(NULL),
+      cmdStreamCacheLen(0),
+      cmdStreamCacheSubSong(0),
+      cmdStreamCacheValid(false),
+      cmdStreamCacheLoops(false),
+      cmdStreamCacheLoopTick(0),
+      cmdStreamTick(0),
+      songRev(0),
+      exportFromStream(false),
+      exportLength(0.0),
+      exportFileCur(0),
+      exportFileCount(1),
       midiBaseChan(0),
       midiPoly(true),
       midiDebug(false),
@@ -1352,7 +1578,13 @@ class DivEngine {
       previewVol(1.0f),
       totalProcessed(0),
       renderPoolThreads(0),
+      sampleFormatBudget(0),
       renderPool(NULL),
+      debugSnapShared(1),
+      debugSnapBack(0),
+      debugSnapFront(2),
+      debugSnapWanted(false),
+      debugSnapValid(false),
       curOrders(NULL),
       curPat(NULL),
       tempIns(NULL),
@@ -1363,10 +1595,7 @@ class DivEngine {
       lastNBIns(0),
       lastNBOuts(0),
       lastNBSize(0),
-      processTime(0),
-      yrw801ROM(NULL),
-      tg100ROM(NULL),
-      mu5ROM(NULL) {
+      processTime(0) {
       memset(isMuted,0,DIV_MAX_CHANS*sizeof(bool));
       memset(keyHit,0,DIV_MAX_CHANS*sizeof(bool));
       memset(dispatchFirstChan,0,DIV_MAX_CHANS*sizeof(int));
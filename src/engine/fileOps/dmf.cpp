@@ -1218,7 +1218,7 @@ SafeWriter* DivEngine::saveDMF(unsigned char version) {
     for (int j=0; j<curSubSong->ordersLen; j++) {
       w->writeC(curOrders->ord[i][j]);
       if (version>=25) {
-        DivPattern* pat=curPat[i].getPattern(j,false);
+        const DivPattern* pat=curPat[i].getPattern(j,false);
         w->writeString(pat->name,true);
       }
     }
@@ -1499,7 +1499,7 @@ SafeWriter* DivEngine::saveDMF(unsigned char version) {
     w->writeC(curPat[i].effectCols);
 
     for (int j=0; j<curSubSong->ordersLen; j++) {
-      DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][j],false);
+      const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][j],false);
       for (int k=0; k<curSubSong->patLen; k++) {
         if ((pat->data[k][0]==101 || pat->data[k][0]==102) && pat->data[k][1]==0) {
           w->writeS(100);
@@ -1844,7 +1844,7 @@ SafeWriter* DivEngine::saveText(bool separatePatterns) {
           w->writeText(fmt::sprintf("%.2X ",k));
 
           for (int l=0; l<chans; l++) {
-            DivPattern* p=s->pat[l].getPattern(s->orders.ord[l][j],false);
+            const DivPattern* p=s->pat[l].getPattern(s->orders.ord[l][j],false);
 
             int note=p->data[k][0];
             int octave=p->data[k][1];
@@ -18,8 +18,9 @@
  */
 
 #include "fileOpsCommon.h"
+#include "../workPool.h"
 
-bool DivEngine::load(unsigned char* f, size_t slen) {
+bool DivEngine::load(unsigned char* f, size_t slen, bool metadataOnly) {
   unsigned char* file;
   size_t len;
   if (slen<18) {
@@ -31,6 +32,23 @@ bool DivEngine::load(unsigned char* f, size_t slen) {
 
   if (!systemsRegistered) registerSystems();
 
+  // step 0: chunked .fur container (each chunk is compressed on its own)
+  if (memcmp(f,DIV_FUR_CHUNKED_MAGIC,16)==0) {
+    logD("loading chunked file...");
+    if (!unpackFurChunks(f,slen,file,len,metadataOnly)) {
+      delete[] f;
+      return false;
+    }
+    delete[] f;
+    if (memcmp(file,DIV_FUR_MAGIC,16)!=0) {
+      logE("chunked file does not contain a module!");
+      lastError="invalid chunked file";
+      delete[] file;
+      return false;
+    }
+    return loadFur(file,len,metadataOnly);
+  }
+
   // step 1: try loading as a zlib-compressed file
   logD("trying zlib...");
   try {
@@ -147,3 +165,114 @@ bool DivEngine::load(unsigned char* f, size_t slen) {
   delete[] file;
   return false;
 }
+
+// data is compressed in blocks which are deflated independently (each one primed with
+// the end of the previous block) and then put together into one zlib stream.
+#define DIV_DEFLATE_BLOCK_SIZE 262144
+#define DIV_DEFLATE_DICT_SIZE 32768
+
+struct DivDeflateBlock {
+  const unsigned char* data;
+  size_t len;
+  size_t dictLen;
+  bool last;
+  unsigned char* out;
+  size_t outLen;
+  bool ok;
+};
+
+struct DivDeflateJobs {
+  std::vector<DivDeflateBlock> blocks;
+  std::atomic<size_t> next;
+};
+
+static void deflateBlocks(void* d) {
+  DivDeflateJobs* jobs=(DivDeflateJobs*)d;
+  size_t i;
+  while ((i=jobs->next++)<jobs->blocks.size()) {
+    DivDeflateBlock& b=jobs->blocks[i];
+    z_stream zl;
+    memset(&zl,0,sizeof(z_stream));
+    // raw deflate. the zlib header and trailer are written separately.
+    if (deflateInit2(&zl,Z_DEFAULT_COMPRESSION,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)!=Z_OK) {
+      b.ok=false;
+      continue;
+    }
+    if (b.dictLen>0) {
+      deflateSetDictionary(&zl,b.data-b.dictLen,b.dictLen);
+    }
+    size_t bound=deflateBound(&zl,b.len)+64;
+    b.out=new unsigned char[bound];
+    zl.next_in=(Bytef*)b.data;
+    zl.avail_in=b.len;
+    zl.next_out=b.out;
+    zl.avail_out=bound;
+    // a sync flush ends the block on a byte boundary without ending the stream
+    int ret=deflate(&zl,b.last?Z_FINISH:Z_SYNC_FLUSH);
+    if (b.last) {
+      b.ok=(ret==Z_STREAM_END);
+    } else {
+      b.ok=(ret==Z_OK && zl.avail_in==0 && zl.avail_out>0);
+    }
+    b.outLen=bound-zl.avail_out;
+    deflateEnd(&zl);
+  }
+}
+
+SafeWriter* DivEngine::compressFile(const unsigned char* data, size_t len) {
+  DivDeflateJobs jobs;
+  jobs.next=0;
+  for (size_t i=0; i<len || i==0; i+=DIV_DEFLATE_BLOCK_SIZE) {
+    DivDeflateBlock b;
+    b.data=data+i;
+    b.len=MIN(len-i,(size_t)DIV_DEFLATE_BLOCK_SIZE);
+    b.dictLen=MIN(i,(size_t)DIV_DEFLATE_DICT_SIZE);
+    b.last=(i+DIV_DEFLATE_BLOCK_SIZE>=len);
+    b.out=NULL;
+    b.outLen=0;
+    b.ok=false;
+    jobs.blocks.push_back(b);
+  }
+
+  unsigned int threads=(renderPoolThreads>1)?MIN(renderPoolThreads,(unsigned int)jobs.blocks.size()):0;
+  if (threads<2) threads=0;
+  DivWorkPool* pool=new DivWorkPool(threads);
+  for (unsigned int i=0; i<MAX(1,threads); i++) {
+    pool->push(deflateBlocks,&jobs);
+  }
+  pool->wait();
+  delete pool;
+
+  SafeWriter* w=NULL;
+  bool ok=true;
+  for (DivDeflateBlock& i: jobs.blocks) {
+    if (!i.ok) ok=false;
+  }
+  if (ok) {
+    w=new SafeWriter;
+    w->init();
+    // zlib header (deflate, 32K window, default compression)
+    w->writeC(0x78);
+    w->writeC(0x9c);
+    for (DivDeflateBlock& i: jobs.blocks) {
+      w->write(i.out,i.outLen);
+    }
+    // trailer (Adler-32 of the data, big-endian)
+    uLong a=adler32(0,Z_NULL,0);
+    for (size_t i=0; i<len; i+=DIV_DEFLATE_BLOCK_SIZE) {
+      a=adler32(a,data+i,MIN(len-i,(size_t)DIV_DEFLATE_BLOCK_SIZE));
+    }
+    w->writeC((a>>24)&0xff);
+    w->writeC((a>>16)&0xff);
+    w->writeC((a>>8)&0xff);
+    w->writeC(a&0xff);
+  } else {
+    logE("could not compress!");
+    lastError="compression error";
+  }
+
+  for (DivDeflateBlock& i: jobs.blocks) {
+    if (i.out!=NULL) delete[] i.out;
+  }
+  return w;
+}
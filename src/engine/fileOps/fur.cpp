@@ -18,6 +18,8 @@
  */
 
 #include "fileOpsCommon.h"
+#include "../workPool.h"
+#include <algorithm>
 
 short newFormatNotes[180]={
   12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, // -5
@@ -691,7 +693,87 @@ void DivEngine::convertOldFlags(unsigned int oldFlags, DivConfig& newFlags, DivS
   }
 }
 
-bool DivEngine::loadFur(unsigned char* file, size_t len) {
+// instruments, wavetables and samples are read by one or more threads taking the next
+// asset from a shared counter. samples go first, as they take the longest to read and convert.
+struct DivFurAssetLoad {
+  unsigned char* file;
+  size_t len;
+  short version;
+  unsigned int formatMask;
+  bool metadataOnly;
+  unsigned int* insPtr;
+  unsigned int* wavePtr;
+  unsigned int* samplePtr;
+  DivSong* song;
+  std::atomic<int> next;
+  // 0: success, 1: couldn't seek, 2: invalid data, 3: premature end of file
+  // order is samples, instruments and then wavetables.
+  int result[768];
+  DivFurAssetLoad():
+    file(NULL),
+    len(0),
+    version(0),
+    formatMask(0),
+    metadataOnly(false),
+    insPtr(NULL),
+    wavePtr(NULL),
+    samplePtr(NULL),
+    song(NULL),
+    next(0) {
+    memset(result,0,768*sizeof(int));
+  }
+};
+
+static void furLoadAssets(void* data) {
+  DivFurAssetLoad* load=(DivFurAssetLoad*)data;
+  DivSong* ds=load->song;
+  int total=ds->sampleLen+ds->insLen+ds->waveLen;
+  int i;
+  while ((i=load->next++)<total) {
+    SafeReader reader=SafeReader(load->file,load->len);
+    int& result=load->result[i];
+    try {
+      if (i<ds->sampleLen) {
+        logD("reading sample %d at %x...",i,load->samplePtr[i]);
+        if (!reader.seek(load->samplePtr[i],SEEK_SET)) {
+          result=1;
+        } else if (ds->sample[i]->readSampleData(reader,load->version,load->metadataOnly)!=DIV_DATA_SUCCESS) {
+          result=2;
+        } else {
+          // convert now so that DivEngine::renderSamples() finds it up to date
+          if (load->formatMask) ds->sample[i]->render(load->formatMask);
+        }
+      } else if (i<ds->sampleLen+ds->insLen) {
+        int index=i-ds->sampleLen;
+        logD("reading instrument %d at %x...",index,load->insPtr[index]);
+        if (!reader.seek(load->insPtr[index],SEEK_SET)) {
+          result=1;
+        } else if (ds->ins[index]->readInsData(reader,load->version)!=DIV_DATA_SUCCESS) {
+          result=2;
+        }
+      } else {
+        int index=i-ds->sampleLen-ds->insLen;
+        logD("reading wavetable %d at %x...",index,load->wavePtr[index]);
+        if (!reader.seek(load->wavePtr[index],SEEK_SET)) {
+          result=1;
+        } else if (ds->wave[index]->readWaveData(reader,load->version)!=DIV_DATA_SUCCESS) {
+          result=2;
+        }
+      }
+    } catch (EndOfFileException& e) {
+      result=3;
+    }
+  }
+}
+
+static void finishAssetPool(DivWorkPool*& pool) {
+  if (pool==NULL) return;
+  pool->wait();
+  delete pool;
+  pool=NULL;
+}
+
+bool DivEngine::loadFur(unsigned char* file, size_t len, bool metadataOnly) {
   unsigned int insPtr[256];
   unsigned int wavePtr[256];
   unsigned int samplePtr[256];
@@ -702,6 +784,8 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
   int numberOfSubSongs=0;
   char magic[5];
   memset(magic,0,5);
+  DivFurAssetLoad assetLoad;
+  DivWorkPool* assetPool=NULL;
   SafeReader reader=SafeReader(file,len);
   warnings="";
   assetDirPtr[0]=0;
@@ -1611,79 +1695,45 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       }
     }
 
-    // read instruments
+    // read instruments, wavetables and samples
+    // these are read (and samples are converted) by assetPool while patterns are read below.
     ds.ins.reserve(ds.insLen);
     for (int i=0; i<ds.insLen; i++) {
-      DivInstrument* ins=new DivInstrument;
-      logD("reading instrument %d at %x...",i,insPtr[i]);
-      if (!reader.seek(insPtr[i],SEEK_SET)) {
-        logE("couldn't seek to instrument %d!",i);
-        lastError=fmt::sprintf("couldn't seek to instrument %d!",i);
-        ds.unload();
-        delete ins;
-        delete[] file;
-        return false;
-      }
-      
-      if (ins->readInsData(reader,ds.version)!=DIV_DATA_SUCCESS) {
-        lastError="invalid instrument header/data!";
-        ds.unload();
-        delete ins;
-        delete[] file;
-        return false;
-      }
-
-      ds.ins.push_back(ins);
+      ds.ins.push_back(new DivInstrument);
     }
-
-    // read wavetables
     ds.wave.reserve(ds.waveLen);
     for (int i=0; i<ds.waveLen; i++) {
-      DivWavetable* wave=new DivWavetable;
-      logD("reading wavetable %d at %x...",i,wavePtr[i]);
-      if (!reader.seek(wavePtr[i],SEEK_SET)) {
-        logE("couldn't seek to wavetable %d!",i);
-        lastError=fmt::sprintf("couldn't seek to wavetable %d!",i);
-        ds.unload();
-        delete wave;
-        delete[] file;
-        return false;
-      }
-
-      if (wave->readWaveData(reader,ds.version)!=DIV_DATA_SUCCESS) {
-        lastError="invalid wavetable header/data!";
-        ds.unload();
-        delete wave;
-        delete[] file;
-        return false;
-      }
-
-      ds.wave.push_back(wave);
+      ds.wave.push_back(new DivWavetable);
     }
-
-    // read samples
     ds.sample.reserve(ds.sampleLen);
     for (int i=0; i<ds.sampleLen; i++) {
-      DivSample* sample=new DivSample;
-
-      if (!reader.seek(samplePtr[i],SEEK_SET)) {
-        logE("couldn't seek to sample %d!",i);
-        lastError=fmt::sprintf("couldn't seek to sample %d!",i);
-        ds.unload();
-        delete sample;
-        delete[] file;
-        return false;
-      }
+      ds.sample.push_back(new DivSample);
+    }
 
-      if (sample->readSampleData(reader,ds.version)!=DIV_DATA_SUCCESS) {
-        lastError="invalid sample header/data!";
-        ds.unload();
-        delete sample;
-        delete[] file;
-        return false;
+    assetLoad.file=file;
+    assetLoad.len=len;
+    assetLoad.version=ds.version;
+    // don't read sample bodies or convert samples when only reading metadata
+    assetLoad.metadataOnly=metadataOnly;
+    assetLoad.formatMask=0;
+    if (!metadataOnly) {
+      assetLoad.formatMask=1U<<16;
+      for (int i=0; i<ds.systemLen; i++) {
+        const DivSysDef* s=getSystemDef(ds.system[i]);
+        if (s==NULL) continue;
+        assetLoad.formatMask|=s->sampleFormatMask;
       }
+    }
+    assetLoad.insPtr=insPtr;
+    assetLoad.wavePtr=wavePtr;
+    assetLoad.samplePtr=samplePtr;
+    assetLoad.song=&ds;
+    assetLoad.next=0;
 
-      ds.sample.push_back(sample);
+    unsigned int assetThreads=(renderPoolThreads>1)?renderPoolThreads:0;
+    assetPool=new DivWorkPool(assetThreads);
+    for (unsigned int i=0; i<MAX(1,assetThreads); i++) {
+      assetPool->push(furLoadAssets,&assetLoad);
     }
 
     // read patterns
@@ -1692,6 +1742,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       if (!reader.seek(i,SEEK_SET)) {
         logE("couldn't seek to pattern in %x!",i);
         lastError=fmt::sprintf("couldn't seek to pattern in %x!",i);
+        finishAssetPool(assetPool);
         ds.unload();
         delete[] file;
         return false;
@@ -1702,6 +1753,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (strcmp(magic,"PATN")!=0 || ds.version<157) {
           logE("%x: invalid pattern header!",i);
           lastError="invalid pattern header!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1721,6 +1773,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (chan<0 || chan>=tchans) {
           logE("pattern channel out of range!",i);
           lastError="pattern channel out of range!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1728,6 +1781,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (index<0 || index>(DIV_MAX_PATTERNS-1)) {
           logE("pattern index out of range!",i);
           lastError="pattern index out of range!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1735,6 +1789,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (subs<0 || subs>=(int)ds.subsong.size()) {
           logE("pattern subsong out of range!",i);
           lastError="pattern subsong out of range!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1810,6 +1865,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (chan<0 || chan>=tchans) {
           logE("pattern channel out of range!",i);
           lastError="pattern channel out of range!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1817,6 +1873,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (index<0 || index>(DIV_MAX_PATTERNS-1)) {
           logE("pattern index out of range!",i);
           lastError="pattern index out of range!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1824,6 +1881,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
         if (subs<0 || subs>=(int)ds.subsong.size()) {
           logE("pattern subsong out of range!",i);
           lastError="pattern subsong out of range!";
+          finishAssetPool(assetPool);
           ds.unload();
           delete[] file;
           return false;
@@ -1852,6 +1910,43 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       }
     }
 
+    // wait for instruments, wavetables and samples
+    finishAssetPool(assetPool);
+    // report errors in file order: instruments, wavetables and then samples
+    for (int j=0; j<ds.insLen+ds.waveLen+ds.sampleLen; j++) {
+      int i=(j<ds.insLen+ds.waveLen)?(ds.sampleLen+j):(j-ds.insLen-ds.waveLen);
+      if (assetLoad.result[i]==0) continue;
+      if (i<ds.sampleLen) {
+        if (assetLoad.result[i]==1) {
+          logE("couldn't seek to sample %d!",i);
+          lastError=fmt::sprintf("couldn't seek to sample %d!",i);
+        } else {
+          lastError="invalid sample header/data!";
+        }
+      } else if (i<ds.sampleLen+ds.insLen) {
+        if (assetLoad.result[i]==1) {
+          logE("couldn't seek to instrument %d!",i-ds.sampleLen);
+          lastError=fmt::sprintf("couldn't seek to instrument %d!",i-ds.sampleLen);
+        } else {
+          lastError="invalid instrument header/data!";
+        }
+      } else {
+        if (assetLoad.result[i]==1) {
+          logE("couldn't seek to wavetable %d!",i-ds.sampleLen-ds.insLen);
+          lastError=fmt::sprintf("couldn't seek to wavetable %d!",i-ds.sampleLen-ds.insLen);
+        } else {
+          lastError="invalid wavetable header/data!";
+        }
+      }
+      if (assetLoad.result[i]==3) {
+        logE("premature end of file!");
+        lastError="incomplete file";
+      }
+      ds.unload();
+      delete[] file;
+      return false;
+    }
+
     if (reader.tell()<reader.size()) {
       if ((reader.tell()+1)!=reader.size()) {
         logW("premature end of song (we are at %x, but size is %x)",reader.tell(),reader.size());
@@ -2069,6 +2164,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
       BUSY_END;
     }
   } catch (EndOfFileException& e) {
+    finishAssetPool(assetPool);
     logE("premature end of file!");
     lastError="incomplete file";
     delete[] file;
@@ -2078,7 +2174,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len) {
   return true;
 }
 
-SafeWriter* DivEngine::saveFur(bool notPrimary, bool newPatternFormat) {
+SafeWriter* DivEngine::saveFur(bool notPrimary, bool newPatternFormat, std::vector<DivFurChunk>* chunks) {
   saveLock.lock();
   std::vector<int> subSongPtr;
   std::vector<int> sysFlagsPtr;
@@ -2194,6 +2290,13 @@ SafeWriter* DivEngine::saveFur(bool notPrimary, bool newPatternFormat) {
   w->writeS(song.insLen);
   w->writeS(song.waveLen);
   w->writeS(song.sampleLen);
+  // keep the patterns of each sub-song together so that they can be compressed as one chunk
+  if (chunks!=NULL) {
+    std::stable_sort(patsToWrite.begin(),patsToWrite.end(),[](const PatToWrite& a, const PatToWrite& b) {
+      return a.subsong<b.subsong;
+    });
+  }
+
   w->writeI(patsToWrite.size());
 
   for (int i=0; i<DIV_MAX_CHIPS; i++) {
@@ -2528,7 +2631,7 @@ SafeWriter* DivEngine::saveFur(bool notPrimary, bool newPatternFormat) {
   /// PATTERN
   patPtr.reserve(patsToWrite.size());
   for (PatToWrite& i: patsToWrite) {
-    DivPattern* pat=song.subsong[i.subsong]->pat[i.chan].getPattern(i.pat,false);
+    const DivPattern* pat=song.subsong[i.subsong]->pat[i.chan].getPattern(i.pat,false);
     patPtr.push_back(w->tell());
 
     if (newPatternFormat) {
@@ -2704,7 +2807,232 @@ SafeWriter* DivEngine::saveFur(bool notPrimary, bool newPatternFormat) {
     w->writeI(assetDirPtr[i]);
   }
 
+  /// CHUNKS
+  if (chunks!=NULL) {
+    chunks->clear();
+    chunks->push_back(DivFurChunk("HEAD",0,0));
+    for (int i=0; i<song.sampleLen; i++) {
+      chunks->push_back(DivFurChunk("SMP2",i,samplePtr[i]));
+    }
+    for (size_t i=0; i<patsToWrite.size(); i++) {
+      if (i>0 && patsToWrite[i].subsong==patsToWrite[i-1].subsong) continue;
+      chunks->push_back(DivFurChunk("PATS",patsToWrite[i].subsong,patPtr[i]));
+    }
+    for (size_t i=0; i<chunks->size(); i++) {
+      size_t end=(i+1<chunks->size())?(*chunks)[i+1].offset:w->size();
+      (*chunks)[i].len=end-(*chunks)[i].offset;
+    }
+  }
+
   saveLock.unlock();
   return w;
 }
 
+// chunked container:
+// - magic (16 bytes)
+// - container version (short)
+// - reserved (short)
+// - uncompressed size (int)
+// - chunk count (int)
+// - chunk directory, 24 bytes per chunk:
+//   - id (4 bytes)
+//   - index (int)
+//   - offset in uncompressed file (int)
+//   - uncompressed length (int)
+//   - offset of compressed data in this file (int)
+//   - compressed length (int)
+// - compressed chunks (one zlib stream each)
+// the uncompressed chunks put together are a regular .fur file.
+#define DIV_FUR_CHUNKED_VERSION 1
+#define DIV_FUR_CHUNKED_HEADER_SIZE 28
+#define DIV_FUR_CHUNKED_DIR_ENTRY 24
+// amount of a sample chunk which is decompressed when only reading metadata (enough for the name)
+#define DIV_FUR_CHUNKED_PEEK 4096
+// deflate can't expand data by more than about 1032:1
+#define DIV_FUR_CHUNKED_MAX_RATIO 1032
+
+SafeWriter* DivEngine::saveFurChunked(bool newPatternFormat) {
+  std::vector<DivFurChunk> chunks;
+  SafeWriter* fur=saveFur(false,newPatternFormat,&chunks);
+  if (fur==NULL) return NULL;
+
+  SafeWriter* w=new SafeWriter;
+  w->init();
+  w->write(DIV_FUR_CHUNKED_MAGIC,16);
+  w->writeS(DIV_FUR_CHUNKED_VERSION);
+  w->writeS(0);
+  w->writeI(fur->size());
+  w->writeI(chunks.size());
+
+  size_t dirSeek=w->tell();
+  for (size_t i=0; i<chunks.size(); i++) {
+    w->write(chunks[i].id,4);
+    w->writeI(chunks[i].index);
+    w->writeI(chunks[i].offset);
+    w->writeI(chunks[i].len);
+    w->writeI(0);
+    w->writeI(0);
+  }
+
+  unsigned char* furData=fur->getFinalBuf();
+  for (size_t i=0; i<chunks.size(); i++) {
+    uLongf compLen=compressBound(chunks[i].len);
+    unsigned char* comp=new unsigned char[compLen];
+    int ret=compress2(comp,&compLen,&furData[chunks[i].offset],chunks[i].len,Z_DEFAULT_COMPRESSION);
+    if (ret!=Z_OK) {
+      logE("could not compress chunk %d! (%d)",(int)i,ret);
+      lastError="compression error";
+      delete[] comp;
+      fur->finish();
+      delete fur;
+      w->finish();
+      delete w;
+      return NULL;
+    }
+    size_t compOffset=w->tell();
+    w->write(comp,compLen);
+    delete[] comp;
+
+    w->seek(dirSeek+i*DIV_FUR_CHUNKED_DIR_ENTRY+16,SEEK_SET);
+    w->writeI(compOffset);
+    w->writeI(compLen);
+    w->seek(0,SEEK_END);
+  }
+
+  fur->finish();
+  delete fur;
+  return w;
+}
+
+// decompress a chunk. if out is shorter than the chunk, only the beginning is decompressed.
+static bool inflateFurChunk(const unsigned char* in, size_t inLen, unsigned char* out, size_t outLen) {
+  z_stream zl;
+  memset(&zl,0,sizeof(z_stream));
+  if (inflateInit(&zl)!=Z_OK) return false;
+  zl.next_in=(Bytef*)in;
+  zl.avail_in=inLen;
+  zl.next_out=out;
+  zl.avail_out=outLen;
+  int ret=inflate(&zl,Z_FINISH);
+  inflateEnd(&zl);
+  if (ret==Z_STREAM_END) return zl.avail_out==0;
+  // partial read
+  return (ret==Z_OK || ret==Z_BUF_ERROR) && zl.avail_out==0;
+}
+
+struct DivFurChunkJob {
+  const unsigned char* in;
+  size_t inLen;
+  unsigned char* out;
+  size_t outLen;
+  bool ok;
+  unsigned int outOffset;
+};
+
+bool DivEngine::unpackFurChunks(unsigned char* f, size_t slen, unsigned char*& file, size_t& len, bool metadataOnly) {
+  SafeReader reader=SafeReader(f,slen);
+  unsigned char* out=NULL;
+  try {
+    reader.seek(16,SEEK_SET);
+    unsigned short version=reader.readS();
+    reader.readS();
+    unsigned int totalLen=reader.readI();
+    unsigned int chunkCount=reader.readI();
+    if (version>DIV_FUR_CHUNKED_VERSION) {
+      logE("chunked container version %d is too new!",version);
+      lastError="this file was saved with a newer version of Furnace";
+      return false;
+    }
+    // the chunks can't decompress to more than this
+    if (totalLen<16 || chunkCount<1 || (size_t)chunkCount*DIV_FUR_CHUNKED_DIR_ENTRY>slen || (size_t)totalLen>slen*DIV_FUR_CHUNKED_MAX_RATIO) {
+      logE("invalid chunked container header!");
+      lastError="invalid chunked file";
+      return false;
+    }
+
+    // read the directory
+    std::vector<DivFurChunkJob> jobs;
+    std::vector<std::pair<unsigned int,unsigned int>> ranges;
+    jobs.reserve(chunkCount);
+    ranges.reserve(chunkCount);
+    for (unsigned int i=0; i<chunkCount; i++) {
+      char id[4];
+      reader.read(id,4);
+      reader.readI();
+      unsigned int offset=reader.readI();
+      unsigned int chunkLen=reader.readI();
+      unsigned int compOffset=reader.readI();
+      unsigned int compLen=reader.readI();
+      if ((size_t)offset+chunkLen>totalLen || (size_t)compOffset+compLen>slen || (size_t)chunkLen>(size_t)compLen*DIV_FUR_CHUNKED_MAX_RATIO) {
+        logE("chunk %d out of range!",i);
+        lastError="invalid chunked file";
+        return false;
+      }
+      ranges.push_back(std::pair<unsigned int,unsigned int>(offset,chunkLen));
+      // sample data is not needed for metadata
+      if (metadataOnly && memcmp(id,"SMP2",4)==0 && chunkLen>DIV_FUR_CHUNKED_PEEK) {
+        chunkLen=DIV_FUR_CHUNKED_PEEK;
+      }
+      jobs.push_back(DivFurChunkJob{&f[compOffset],compLen,NULL,chunkLen,false,offset});
+    }
+
+    // the chunks must cover the whole file exactly once
+    std::sort(ranges.begin(),ranges.end());
+    size_t covered=0;
+    for (std::pair<unsigned int,unsigned int>& i: ranges) {
+      if (i.first!=covered) {
+        logE("chunks overlap or leave a gap at %x!",(unsigned int)covered);
+        lastError="invalid chunked file";
+        return false;
+      }
+      covered+=i.second;
+    }
+    if (covered!=totalLen) {
+      logE("chunks do not cover the whole file! (%x != %x)",(unsigned int)covered,totalLen);
+      lastError="invalid chunked file";
+      return false;
+    }
+
+    // not cleared, as the chunks cover all of it. when only reading metadata, the rest of
+    // each sample chunk is left untouched and never read, so it only takes up address space.
+    out=new unsigned char[totalLen];
+    for (DivFurChunkJob& i: jobs) {
+      i.out=&out[i.outOffset];
+    }
+
+    unsigned int threads=(renderPoolThreads>1)?MIN(renderPoolThreads,chunkCount):0;
+    DivWorkPool* pool=new DivWorkPool(threads);
+    for (DivFurChunkJob& i: jobs) {
+      pool->push([](void* d) {
+        DivFurChunkJob* job=(DivFurChunkJob*)d;
+        job->ok=inflateFurChunk(job->in,job->inLen,job->out,job->outLen);
+      },&i);
+    }
+    pool->wait();
+    delete pool;
+
+    for (size_t i=0; i<jobs.size(); i++) {
+      if (!jobs[i].ok) {
+        logE("could not decompress chunk %d!",(int)i);
+        lastError="decompression error";
+        delete[] out;
+        return false;
+      }
+    }
+
+    file=out;
+    len=totalLen;
+  } catch (EndOfFileException& e) {
+    logE("premature end of file!");
+    lastError="incomplete file";
+    if (out!=NULL) delete[] out;
+    return false;
+  } catch (std::bad_alloc& e) {
+    logE("out of memory while unpacking chunks!");
+    lastError="not enough memory to load this file";
+    if (out!=NULL) delete[] out;
+    return false;
+  }
+  return true;
+}
+
@@ -2154,7 +2154,7 @@ DivDataErrors DivInstrument::readInsDataNew(SafeReader& reader, short version, b
 
   // <187 C64 cutoff macro compatibility
   if (type==DIV_INS_C64 && volIsCutoff && version<187) {
-    memcpy(&std.algMacro,&std.volMacro,sizeof(DivInstrumentMacro));
+    std.algMacro=std.volMacro;
     std.algMacro.macroType=DIV_MACRO_ALG;
     std.volMacro=DivInstrumentMacro(DIV_MACRO_VOL,true);
 
@@ -2906,7 +2906,7 @@ DivDataErrors DivInstrument::readInsDataOld(SafeReader &reader, short version) {
 
   // <187 C64 cutoff macro compatibility
   if (type==DIV_INS_C64 && volIsCutoff && version<187) {
-    memcpy(&std.algMacro,&std.volMacro,sizeof(DivInstrumentMacro));
+    std.algMacro=std.volMacro;
     std.algMacro.macroType=DIV_MACRO_ALG;
     std.volMacro=DivInstrumentMacro(DIV_MACRO_VOL,true);
 
@@ -246,9 +246,58 @@ struct DivInstrumentFM {
   }
 };
 
+/**
+ * storage for macro values.
+ * nothing is allocated until the macro is written to (or a pointer to its
+ * data is requested), so unused macros only take up a pointer.
+ * once allocated the buffer is never resized, since the audio thread may
+ * be reading it while the macro is being edited.
+ */
+class DivMacroData {
+  int* data;
+  public:
+    int* get() {
+      if (data==NULL) {
+        data=new int[256];
+        memset(data,0,256*sizeof(int));
+      }
+      return data;
+    }
+    bool allocated() const {
+      return data!=NULL;
+    }
+    template<typename T> int& operator[](T pos) {
+      return get()[pos];
+    }
+    template<typename T> int operator[](T pos) const {
+      return (data==NULL)?0:data[pos];
+    }
+    operator int*() {
+      return get();
+    }
+    DivMacroData& operator=(const DivMacroData& other) {
+      if (this==&other) return *this;
+      if (other.data==NULL) {
+        if (data!=NULL) memset(data,0,256*sizeof(int));
+      } else {
+        memcpy(get(),other.data,256*sizeof(int));
+      }
+      return *this;
+    }
+    DivMacroData(const DivMacroData& other):
+      data(NULL) {
+      if (other.data!=NULL) memcpy(get(),other.data,256*sizeof(int));
+    }
+    DivMacroData():
+      data(NULL) {}
+    ~DivMacroData() {
+      delete[] data;
+    }
+};
+
 // this is getting out of hand
 struct DivInstrumentMacro {
-  int val[256];
+  DivMacroData val;
   unsigned int mode;
   unsigned char open;
   unsigned char len, delay, speed, loop, rel;
@@ -273,7 +322,6 @@ struct DivInstrumentMacro {
     vScroll(0),
     vZoom(-1),
     lenMemory(0) {
-    memset(val,0,256*sizeof(int));
     memset(typeMemory,0,16*sizeof(int));
   }
 };
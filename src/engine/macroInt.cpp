@@ -38,7 +38,7 @@
 #define LFO_LOOP source.val[14]
 #define LFO_GLOBAL source.val[15]
 
-void DivMacroStruct::prepare(DivInstrumentMacro& source, DivEngine* e) {
+void DivMacroStruct::prepare(const DivInstrumentMacro& source, DivEngine* e) {
   has=had=actualHad=will=true;
   mode=source.mode;
   type=(source.open>>1)&3;
@@ -47,7 +47,7 @@ void DivMacroStruct::prepare(DivInstrumentMacro& source, DivEngine* e) {
   lfoPos=LFO_PHASE;
 }
 
-void DivMacroStruct::doMacro(DivInstrumentMacro& source, bool released, bool tick) {
+void DivMacroStruct::doMacro(const DivInstrumentMacro& source, bool released, bool tick) {
   if (!tick) {
     had=false;
     return;
@@ -275,7 +275,7 @@ void DivMacroInt::mask(unsigned char id, bool enabled) {
 
 void DivMacroInt::restart(unsigned char id) {
   DivMacroStruct* macroState=NULL;
-  DivInstrumentMacro* macro=NULL;
+  const DivInstrumentMacro* macro=NULL;
 
   if (e==NULL) return;
   if (ins==NULL) return;
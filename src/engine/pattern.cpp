@@ -21,6 +21,80 @@
 #include "../ta-log.h"
 
 static DivPattern emptyPat;
+static void fillEmpty(short* rows, int count) {
+  memset(rows,-1,count*DIV_MAX_COLS*sizeof(short));
+  for (int i=0; i<count; i++) {
+    rows[i*DIV_MAX_COLS]=0;
+    rows[i*DIV_MAX_COLS+1]=0;
+  }
+}
+
+static const short* getEmptyRow() {
+  static short emptyRow[DIV_MAX_COLS];
+  static bool emptyRowInit=(fillEmpty(emptyRow,1),true);
+  (void)emptyRowInit;
+  return emptyRow;
+}
+
+short* DivPatternData::allocBlock(int which) {
+  short* b=new short[DIV_PATTERN_BLOCK_ROWS*DIV_MAX_COLS];
+  short* expected=NULL;
+  fillEmpty(b,DIV_PATTERN_BLOCK_ROWS);
+  if (!blocks[which].compare_exchange_strong(expected,b,std::memory_order_acq_rel)) {
+    // another thread got there first
+    delete[] b;
+    return expected;
+  }
+  return b;
+}
+
+const short* DivPatternData::operator[](int row) const {
+  short* b=blocks[row/DIV_PATTERN_BLOCK_ROWS].load(std::memory_order_acquire);
+  if (b==NULL) return getEmptyRow();
+  return b+(row%DIV_PATTERN_BLOCK_ROWS)*DIV_MAX_COLS;
+}
+
+void DivPatternData::clear() {
+  for (int i=0; i<DIV_PATTERN_BLOCKS; i++) {
+    short* b=blocks[i].load(std::memory_order_acquire);
+    if (b!=NULL) fillEmpty(b,DIV_PATTERN_BLOCK_ROWS);
+  }
+}
+
+bool DivPatternData::operator==(const DivPatternData& other) const {
+  for (int i=0; i<DIV_MAX_ROWS; i++) {
+    if (memcmp((*this)[i],other[i],DIV_MAX_COLS*sizeof(short))!=0) return false;
+  }
+  return true;
+}
+
+DivPatternData& DivPatternData::operator=(const DivPatternData& other) {
+  if (this==&other) return *this;
+  for (int i=0; i<DIV_PATTERN_BLOCKS; i++) {
+    short* src=other.blocks[i].load(std::memory_order_acquire);
+    short* dest=blocks[i].load(std::memory_order_acquire);
+    if (src==NULL) {
+      if (dest!=NULL) fillEmpty(dest,DIV_PATTERN_BLOCK_ROWS);
+      continue;
+    }
+    if (dest==NULL) dest=allocBlock(i);
+    memcpy(dest,src,DIV_PATTERN_BLOCK_ROWS*DIV_MAX_COLS*sizeof(short));
+  }
+  return *this;
+}
+
+DivPatternData::DivPatternData() {
+  for (int i=0; i<DIV_PATTERN_BLOCKS; i++) {
+    blocks[i]=NULL;
+  }
+}
+
+DivPatternData::~DivPatternData() {
+  for (int i=0; i<DIV_PATTERN_BLOCKS; i++) {
+    short* b=blocks[i].load();
+    if (b!=NULL) delete[] b;
+  }
+}
 
 DivPattern::DivPattern() {
   clear();
@@ -45,7 +119,7 @@ std::vector<std::pair<int,int>> DivChannelData::optimize() {
       for (int j=0; j<DIV_MAX_PATTERNS; j++) {
         if (j==i) continue;
         if (data[j]==NULL) continue;
-        if (memcmp(data[i]->data,data[j]->data,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short))==0) {
+        if (data[i]->data==data[j]->data) {
           delete data[j];
           data[j]=NULL;
           logV("%d == %d",i,j);
@@ -84,17 +158,13 @@ void DivChannelData::wipePatterns() {
   }
 }
 
-void DivPattern::copyOn(DivPattern* dest) {
+void DivPattern::copyOn(DivPattern* dest) const {
   dest->name=name;
-  memcpy(dest->data,data,sizeof(data));
+  dest->data=data;
 }
 
 void DivPattern::clear() {
-  memset(data,-1,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
-  for (int i=0; i<DIV_MAX_ROWS; i++) {
-    data[i][0]=0;
-    data[i][1]=0;
-  }
+  data.clear();
 }
 
 DivChannelData::DivChannelData():
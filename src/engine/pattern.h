@@ -20,9 +20,45 @@
 #include "safeReader.h"
 #include "../pch.h"
 
+#include <atomic>
+
+#define DIV_PATTERN_BLOCK_ROWS 16
+#define DIV_PATTERN_BLOCKS (DIV_MAX_ROWS/DIV_PATTERN_BLOCK_ROWS)
+
+/**
+ * pattern row storage.
+ * rows are allocated in blocks of DIV_PATTERN_BLOCK_ROWS upon first access,
+ * so a pattern only takes up space for the rows that are actually used.
+ * each row is DIV_MAX_COLS shorts (one cache line), laid out contiguously
+ * within a block.
+ * blocks may be allocated by any thread but are only freed on destruction.
+ */
+class DivPatternData {
+  std::atomic<short*> blocks[DIV_PATTERN_BLOCKS];
+  short* allocBlock(int which);
+  public:
+    short* operator[](int row) {
+      short* b=blocks[row/DIV_PATTERN_BLOCK_ROWS].load(std::memory_order_acquire);
+      if (b==NULL) b=allocBlock(row/DIV_PATTERN_BLOCK_ROWS);
+      return b+(row%DIV_PATTERN_BLOCK_ROWS)*DIV_MAX_COLS;
+    }
+    const short* operator[](int row) const;
+
+    /**
+     * reset all rows to empty. does not free memory.
+     */
+    void clear();
+
+    bool operator==(const DivPatternData& other) const;
+    DivPatternData& operator=(const DivPatternData& other);
+    DivPatternData(const DivPatternData& other)=delete;
+    DivPatternData();
+    ~DivPatternData();
+};
+
 struct DivPattern {
   String name;
-  short data[DIV_MAX_ROWS][DIV_MAX_COLS];
+  DivPatternData data;
 
   /**
    * clear the pattern.
@@ -33,7 +69,7 @@ struct DivPattern {
    * copy this pattern to another.
    * @param dest the destination pattern.
    */
-  void copyOn(DivPattern* dest);
+  void copyOn(DivPattern* dest) const;
   DivPattern();
 };
 
@@ -831,6 +831,8 @@ void DivPlatformSNES::initEcho() {
 
 void DivPlatformSNES::reset() {
   writes.clear();
+  delay=0;
+  noiseFreq=0;
 
   memcpy(sampleMem,copyOfSampleMem,65536);
   dsp.init(sampleMem);
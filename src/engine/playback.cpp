@@ -444,7 +444,7 @@ bool DivEngine::perSystemPreEffect(int ch, unsigned char effect, unsigned char e
 void DivEngine::processRowPre(int i) {
   int whatOrder=curOrder;
   int whatRow=curRow;
-  DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
+  const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
   for (int j=0; j<curPat[i].effectCols; j++) {
     short effect=pat->data[whatRow][4+(j<<1)];
     short effectVal=pat->data[whatRow][5+(j<<1)];
@@ -458,7 +458,7 @@ void DivEngine::processRowPre(int i) {
 void DivEngine::processRow(int i, bool afterDelay) {
   int whatOrder=afterDelay?chan[i].delayOrder:curOrder;
   int whatRow=afterDelay?chan[i].delayRow:curRow;
-  DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
+  const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
   // pre effects
   if (!afterDelay) {
     bool returnAfterPre=false;
@@ -1139,7 +1139,7 @@ void DivEngine::nextRow() {
       snprintf(pb,4095," %.2x",curOrders->ord[i][curOrder]);
       strcat(pb1,pb);
       
-      DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
+      const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
       snprintf(pb2,4095,"\x1b[37m %s",
               formatNote(pat->data[curRow][0],pat->data[curRow][1]));
       strcat(pb3,pb2);
@@ -1268,7 +1268,7 @@ void DivEngine::nextRow() {
 
   // post row details
   for (int i=0; i<chans; i++) {
-    DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
+    const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
     if (!(pat->data[curRow][0]==0 && pat->data[curRow][1]==0)) {
       if (pat->data[curRow][0]!=100 && pat->data[curRow][0]!=101 && pat->data[curRow][0]!=102) {
         if (!chan[i].legato) {
@@ -1419,7 +1419,16 @@ bool DivEngine::nextTick(bool noAccum, bool inhibitLowLat) {
     pendingNotes.pop_front();
   }
 
-  if (!freelance) {
+  // cmdStreamTick counts whole ticks (not sub-ticks in low latency mode), and this one is
+  // a whole tick if the sub-tick counter below is about to wrap around.
+  if (cmdStreamSong && cmdStreamCacheLoops && subticks<=1 && cmdStreamTick>=cmdStreamCacheLoopTick) {
+    // loop point reached. continue from patterns
+    stopCommandStream();
+    restoreCommandStreamLoop();
+  }
+
+  // when playing a precompiled song, the command stream player takes over
+  if (!freelance && !cmdStreamSong) {
     if (--subticks<=0) {
       subticks=tickMult;
 
@@ -1594,10 +1603,15 @@ bool DivEngine::nextTick(bool noAccum, bool inhibitLowLat) {
   }
 
   if (subticks==tickMult && cmdStreamInt) {
+    if (cmdStreamSong) cmdStreamTick++;
     if (!cmdStreamInt->tick()) {
-      cmdStreamInt->cleanup();
-      delete cmdStreamInt;
-      cmdStreamInt=NULL;
+      // end of a precompiled song (unless it loops, in which case we wait for the loop tick)
+      if (!cmdStreamSong) {
+        stopCommandStream();
+      } else if (!cmdStreamCacheLoops) {
+        shallStop=true;
+        stopCommandStream();
+      }
     }
   }
 
@@ -2306,6 +2320,10 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       }
     }
   }
+
+  if (debugSnapWanted.exchange(false)) {
+    captureDebugSnapshot();
+  }
   isBusy.unlock();
 
   std::chrono::steady_clock::time_point ts_processEnd=std::chrono::steady_clock::now();
@@ -36,6 +36,13 @@ extern "C" {
 #include "../../extern/adpcm/ymz_codec.h"
 }
 #include "brrUtils.h"
+#include <zlib.h>
+
+size_t DivSampleHistory::getSize() {
+  if (data==NULL) return sizeof(DivSampleHistory);
+  if (diff) return sizeof(DivSampleHistory)+length-diffStart-diffEnd;
+  return sizeof(DivSampleHistory)+length;
+}
 
 DivSampleHistory::~DivSampleHistory() {
   if (data!=NULL) delete[] data;
@@ -96,7 +103,7 @@ static double samplePitchesSD[11]={
   2, 3, 4, 5, 6
 };
 
-DivDataErrors DivSample::readSampleData(SafeReader& reader, short version) {
+DivDataErrors DivSample::readSampleData(SafeReader& reader, short version, bool metadataOnly) {
   int vol=0;
   int pitch=0;
   char magic[4];
@@ -175,6 +182,9 @@ DivDataErrors DivSample::readSampleData(SafeReader& reader, short version) {
     }
   }
 
+  // skip the sample body
+  if (metadataOnly) return DIV_DATA_SUCCESS;
+
   if (version>=58) { // modern sample
     init(samples);
     reader.read(getCurBuf(),getCurBufLen());
@@ -512,6 +522,8 @@ bool DivSample::saveRaw(const char* path) {
 // 16-bit memory is padded to 512, to make things easier for ADPCM-A/B.
 bool DivSample::initInternal(DivSampleDepth d, int count) {
   logV("initInternal(%d,%d)",(int)d,count);
+  if (d<DIV_SAMPLE_DEPTH_MAX) renderKeyValid[d]=false;
+  if (d==DIV_SAMPLE_DEPTH_8BIT || d==DIV_SAMPLE_DEPTH_16BIT) invalidatePeaks();
   switch (d) {
     case DIV_SAMPLE_DEPTH_1BIT: // 1-bit
       if (data1!=NULL) delete[] data1;
@@ -793,6 +805,7 @@ bool DivSample::insert(unsigned int pos, unsigned int length) {
 void DivSample::convert(DivSampleDepth newDepth) {
   render();
   depth=newDepth;
+  memset(renderKeyValid,0,DIV_SAMPLE_DEPTH_MAX*sizeof(bool));
   switch (depth) {
     case DIV_SAMPLE_DEPTH_1BIT:
       setSampleCount((samples+7)&(~7));
@@ -1163,6 +1176,7 @@ bool DivSample::resample(double sRate, double tRate, int filter) {
 }
 
 #define NOT_IN_FORMAT(x) (depth!=x && formatMask&(1U<<(unsigned int)x))
+#define NEEDS_RENDER(x) (NOT_IN_FORMAT(x) && !(renderKeyValid[x] && renderKey[x]==key))
 
 union IntFloat {
   unsigned int i;
@@ -1277,7 +1291,18 @@ void DivSample::render(unsigned int formatMask) {
   }
 
   // step 2: render to other formats
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_1BIT)) { // 1-bit
+  // formats which were already rendered from the same data and parameters
+  // are skipped.
+  unsigned int key=crc32(0,(const unsigned char*)data16,samples*sizeof(short));
+  if (key!=peaksKey) {
+    peaksKey=key;
+    invalidatePeaks();
+  }
+  int keyParams[6]={(int)samples,loopStart,loopEnd,loop,brrEmphasis,dither};
+  key=crc32(key,(const unsigned char*)keyParams,sizeof(keyParams));
+  if (depth<DIV_SAMPLE_DEPTH_MAX) renderKeyValid[depth]=false;
+
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_1BIT)) { // 1-bit
     if (!initInternal(DIV_SAMPLE_DEPTH_1BIT,samples)) return;
     for (unsigned int i=0; i<samples; i++) {
       if (data16[i]>0) {
@@ -1285,7 +1310,7 @@ void DivSample::render(unsigned int formatMask) {
       }
     }
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_1BIT_DPCM)) { // DPCM
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_1BIT_DPCM)) { // DPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_1BIT_DPCM,samples)) return;
     int accum=63;
     int next=63;
@@ -1302,24 +1327,24 @@ void DivSample::render(unsigned int formatMask) {
       if (accum>127) accum=127;
     }
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_YMZ_ADPCM)) { // YMZ ADPCM
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_YMZ_ADPCM)) { // YMZ ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_YMZ_ADPCM,samples)) return;
     ymz_encode(data16,dataZ,(samples+7)&(~0x7));
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_QSOUND_ADPCM)) { // QSound ADPCM
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_QSOUND_ADPCM)) { // QSound ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_QSOUND_ADPCM,samples)) return;
     bs_encode(data16,dataQSoundA,samples);
   }
   // TODO: pad to 256.
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_A)) { // ADPCM-A
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_ADPCM_A)) { // ADPCM-A
     if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_A,samples)) return;
     yma_encode(data16,dataA,(samples+511)&(~0x1ff));
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_B)) { // ADPCM-B
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_ADPCM_B)) { // ADPCM-B
     if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_B,samples)) return;
     ymb_encode(data16,dataB,(samples+511)&(~0x1ff));
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_K)) { // K05 ADPCM
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_ADPCM_K)) { // K05 ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_K,samples)) return;
     signed char accum=0;
     unsigned char out=0;
@@ -1378,7 +1403,7 @@ void DivSample::render(unsigned int formatMask) {
       }
     }
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_8BIT)) { // 8-bit PCM
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_8BIT)) { // 8-bit PCM
     if (!initInternal(DIV_SAMPLE_DEPTH_8BIT,samples)) return;
     if (dither) {
       unsigned short lfsr=0x6438;
@@ -1399,16 +1424,16 @@ void DivSample::render(unsigned int formatMask) {
       }
     }
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_BRR)) { // BRR
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_BRR)) { // BRR
     int sampleCount=loop?loopEnd:samples;
     if (!initInternal(DIV_SAMPLE_DEPTH_BRR,sampleCount)) return;
     brrEncode(data16,dataBRR,sampleCount,loop?loopStart:-1,brrEmphasis);
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_VOX)) { // VOX
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_VOX)) { // VOX
     if (!initInternal(DIV_SAMPLE_DEPTH_VOX,samples)) return;
     oki_encode(data16,dataVOX,samples);
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_MULAW)) { // µ-law
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_MULAW)) { // µ-law
     if (!initInternal(DIV_SAMPLE_DEPTH_MULAW,samples)) return;
     for (unsigned int i=0; i<samples; i++) {
       IntFloat s;
@@ -1421,7 +1446,7 @@ void DivSample::render(unsigned int formatMask) {
       dataMuLaw[i]=(((data16[i]<0)?0x80:0)|(s.i&0x03f80000)>>19)^0xff;
     }
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_C219)) { // C219
+  if (NEEDS_RENDER(DIV_SAMPLE_DEPTH_C219)) { // C219
     if (!initInternal(DIV_SAMPLE_DEPTH_C219,samples)) return;
     for (unsigned int i=0; i<samples; i++) {
       short s=data16[i];
@@ -1442,6 +1467,13 @@ void DivSample::render(unsigned int formatMask) {
       dataC219[i]=x|(negate?0x80:0);
     }
   }
+
+  // step 3: remember what the rendered formats were made from
+  for (int i=0; i<DIV_SAMPLE_DEPTH_MAX; i++) {
+    if (!NOT_IN_FORMAT(i)) continue;
+    renderKey[i]=key;
+    renderKeyValid[i]=true;
+  }
 }
 
 void* DivSample::getCurBuf() {
@@ -1512,6 +1544,143 @@ unsigned int DivSample::getCurBufLen() {
   return 0;
 }
 
+void DivSample::invalidatePeaks(unsigned int start, unsigned int end) {
+  if (start>=end) return;
+  if (peaksDirtyStart>=peaksDirtyEnd) {
+    peaksDirtyStart=start;
+    peaksDirtyEnd=end;
+  } else {
+    if (start<peaksDirtyStart) peaksDirtyStart=start;
+    if (end>peaksDirtyEnd) peaksDirtyEnd=end;
+  }
+}
+
+#define PEAK_SAMPLE(x) (use8?(short)(data8[x]*256):data16[x])
+#define PEAK_BLOCK (1U<<DIV_SAMPLE_PEAK_SHIFT)
+
+bool DivSample::getPeak(unsigned int start, unsigned int end, short& outMin, short& outMax) {
+  bool use8=(depth==DIV_SAMPLE_DEPTH_8BIT);
+  if (use8?(data8==NULL):(data16==NULL)) return false;
+  if (end>samples) end=samples;
+  if (start>=end) return false;
+
+  // reallocate if the sample count or the source changed
+  if (peaksSamples!=samples || peaks8!=use8) {
+    peaksSamples=samples;
+    peaks8=use8;
+    for (int i=0; i<DIV_SAMPLE_PEAK_LEVELS; i++) {
+      unsigned int blockSize=PEAK_BLOCK<<i;
+      peaks[i].resize(((samples+blockSize-1)>>(DIV_SAMPLE_PEAK_SHIFT+i))*2);
+    }
+    peaksDirtyStart=0;
+    peaksDirtyEnd=UINT_MAX;
+  }
+
+  // rebuild changed blocks, from the smallest ones up
+  if (peaksDirtyStart<peaksDirtyEnd) {
+    unsigned int dirtyEnd=MIN(peaksDirtyEnd,samples);
+    if (peaksDirtyStart<dirtyEnd) {
+      unsigned int bStart=peaksDirtyStart>>DIV_SAMPLE_PEAK_SHIFT;
+      unsigned int bEnd=((dirtyEnd-1)>>DIV_SAMPLE_PEAK_SHIFT)+1;
+      for (unsigned int i=bStart; i<bEnd; i++) {
+        unsigned int s0=i<<DIV_SAMPLE_PEAK_SHIFT;
+        unsigned int s1=MIN(s0+PEAK_BLOCK,samples);
+        short candMin=32767;
+        short candMax=-32768;
+        for (unsigned int j=s0; j<s1; j++) {
+          short val=PEAK_SAMPLE(j);
+          if (candMin>val) candMin=val;
+          if (candMax<val) candMax=val;
+        }
+        peaks[0][i<<1]=candMin;
+        peaks[0][(i<<1)+1]=candMax;
+      }
+      for (int l=1; l<DIV_SAMPLE_PEAK_LEVELS; l++) {
+        const std::vector<short>& below=peaks[l-1];
+        unsigned int belowCount=below.size()>>1;
+        bStart>>=1;
+        bEnd=((bEnd-1)>>1)+1;
+        for (unsigned int i=bStart; i<bEnd; i++) {
+          unsigned int c=i<<1;
+          short candMin=below[c<<1];
+          short candMax=below[(c<<1)+1];
+          if (c+1<belowCount) {
+            if (candMin>below[(c+1)<<1]) candMin=below[(c+1)<<1];
+            if (candMax<below[((c+1)<<1)+1]) candMax=below[((c+1)<<1)+1];
+          }
+          peaks[l][i<<1]=candMin;
+          peaks[l][(i<<1)+1]=candMax;
+        }
+      }
+    }
+    peaksDirtyStart=0;
+    peaksDirtyEnd=0;
+  }
+
+  short candMin=32767;
+  short candMax=-32768;
+
+  // samples before the first whole block
+  while (start<end && (start&(PEAK_BLOCK-1))) {
+    short val=PEAK_SAMPLE(start);
+    if (candMin>val) candMin=val;
+    if (candMax<val) candMax=val;
+    start++;
+  }
+
+  // whole blocks, using the largest ones which fit
+  int level=0;
+  while (start+PEAK_BLOCK<=end) {
+    while (level+1<DIV_SAMPLE_PEAK_LEVELS && !(start&((PEAK_BLOCK<<(level+1))-1)) && start+(PEAK_BLOCK<<(level+1))<=end) level++;
+    unsigned int i=(start>>(DIV_SAMPLE_PEAK_SHIFT+level))<<1;
+    if (candMin>peaks[level][i]) candMin=peaks[level][i];
+    if (candMax<peaks[level][i+1]) candMax=peaks[level][i+1];
+    start+=PEAK_BLOCK<<level;
+    while (level>0 && start+(PEAK_BLOCK<<level)>end) level--;
+  }
+
+  // samples after the last whole block
+  while (start<end) {
+    short val=PEAK_SAMPLE(start);
+    if (candMin>val) candMin=val;
+    if (candMax<val) candMax=val;
+    start++;
+  }
+
+  outMin=candMin;
+  outMax=candMax;
+  return true;
+}
+
+#define FREE_UNUSED_FORMAT(d,x,l) \
+  if (x!=NULL && depth!=d && !(formatMask&(1U<<d))) { \
+    freed+=l; \
+    if (!dryRun) { \
+      delete[] x; \
+      x=NULL; \
+      l=0; \
+      renderKeyValid[d]=false; \
+    } \
+  }
+
+size_t DivSample::freeUnusedFormats(unsigned int formatMask, bool dryRun) {
+  size_t freed=0;
+  // 16-bit data is always kept
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_1BIT,data1,length1);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_1BIT_DPCM,dataDPCM,lengthDPCM);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_YMZ_ADPCM,dataZ,lengthZ);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_QSOUND_ADPCM,dataQSoundA,lengthQSoundA);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_A,dataA,lengthA);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_B,dataB,lengthB);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_K,dataK,lengthK);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_8BIT,data8,length8);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_BRR,dataBRR,lengthBRR);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_VOX,dataVOX,lengthVOX);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_MULAW,dataMuLaw,lengthMuLaw);
+  FREE_UNUSED_FORMAT(DIV_SAMPLE_DEPTH_C219,dataC219,lengthC219);
+  return freed;
+}
+
 DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
   DivSampleHistory* h;
   if (data) {
@@ -1532,12 +1701,81 @@ DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
       delete h;
       redoHist.pop_back();
     }
-    if (undoHist.size()>100) undoHist.pop_front();
+    // the previous step will be applied to the current data, so only the
+    // part which is about to change needs to be kept
+    if (!undoHist.empty()) compactUndo(undoHist.back());
     undoHist.push_back(h);
+
+    // limit the history by size
+    size_t histSize=0;
+    for (size_t i=0; i<undoHist.size(); i++) {
+      histSize+=undoHist[i]->getSize();
+    }
+    while (undoHist.size()>1 && (undoHist.size()>DIV_SAMPLE_UNDO_MAX_STEPS || histSize>DIV_SAMPLE_UNDO_MAX_SIZE)) {
+      DivSampleHistory* oldest=undoHist.front();
+      histSize-=oldest->getSize();
+      delete oldest;
+      undoHist.pop_front();
+    }
   }
   return h;
 }
 
+void DivSample::compactUndo(DivSampleHistory* h) {
+  if (h==NULL) return;
+  if (!h->hasSample || h->diff || h->data==NULL) return;
+  // depth changes are kept as full snapshots
+  if (h->depth!=depth) return;
+
+  unsigned char* cur=(unsigned char*)getCurBuf();
+  unsigned int curLen=getCurBufLen();
+  if (cur==NULL) return;
+
+  // find the changed range
+  unsigned int common=MIN(curLen,h->length);
+  unsigned int start=0;
+  unsigned int end=0;
+  while (start<common && h->data[start]==cur[start]) start++;
+  while (end<common-start && h->data[h->length-1-end]==cur[curLen-1-end]) end++;
+  if (start==0 && end==0) return;
+
+  unsigned int changedLen=h->length-start-end;
+  unsigned char* changed=NULL;
+  if (changedLen>0) {
+    changed=new unsigned char[changedLen];
+    memcpy(changed,h->data+start,changedLen);
+  }
+  delete[] h->data;
+  h->data=changed;
+  h->diff=true;
+  h->diffStart=start;
+  h->diffEnd=end;
+  h->diffLength=curLen;
+}
+
+bool DivSample::expandUndo(DivSampleHistory* h) {
+  if (h==NULL) return false;
+  if (!h->diff) return true;
+
+  unsigned char* cur=(unsigned char*)getCurBuf();
+  unsigned int curLen=getCurBufLen();
+  if (cur==NULL || h->depth!=depth || curLen!=h->diffLength) {
+    logE("undo step does not match current sample data! %d != %d",curLen,h->diffLength);
+    return false;
+  }
+
+  h->diff=false;
+  unsigned char* full=new unsigned char[h->length];
+  memcpy(full,cur,h->diffStart);
+  if (h->data!=NULL) {
+    memcpy(full+h->diffStart,h->data,h->length-h->diffStart-h->diffEnd);
+    delete[] h->data;
+  }
+  memcpy(full+h->length-h->diffEnd,cur+curLen-h->diffEnd,h->diffEnd);
+  h->data=full;
+  return true;
+}
+
 #define applyHistory \
   depth=h->depth; \
   if (h->hasSample) { \
@@ -1565,11 +1803,23 @@ DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
 int DivSample::undo() {
   if (undoHist.empty()) return 0;
   DivSampleHistory* h=undoHist.back();
+
+  if (!expandUndo(h)) {
+    // this step (and the ones before it, which were reduced against the data
+    // it would have restored) can't be applied. drop them and leave the sample alone.
+    while (!undoHist.empty()) {
+      delete undoHist.back();
+      undoHist.pop_back();
+    }
+    return 0;
+  }
+
   DivSampleHistory* redo=prepareUndo(h->hasSample,true);
 
   int ret=h->hasSample?2:1;
 
   applyHistory;
+  compactUndo(redo);
 
   redoHist.push_back(redo);
   delete h;
@@ -1580,11 +1830,23 @@ int DivSample::undo() {
 int DivSample::redo() {
   if (redoHist.empty()) return 0;
   DivSampleHistory* h=redoHist.back();
+
+  if (!expandUndo(h)) {
+    // this step (and the ones before it, which were reduced against the data
+    // it would have restored) can't be applied. drop them and leave the sample alone.
+    while (!redoHist.empty()) {
+      delete redoHist.back();
+      redoHist.pop_back();
+    }
+    return 0;
+  }
+
   DivSampleHistory* undo=prepareUndo(h->hasSample,true);
 
   int ret=h->hasSample?2:1;
 
   applyHistory;
+  compactUndo(undo);
 
   undoHist.push_back(undo);
   delete h;
@@ -25,6 +25,18 @@
 #include "safeWriter.h"
 #include "dataErrors.h"
 #include "../fixedQueue.h"
+#include "../pch.h"
+#include <climits>
+
+// maximum amount of memory used by the undo history of a sample
+#define DIV_SAMPLE_UNDO_MAX_SIZE (64*1024*1024)
+// maximum number of undo steps of a sample
+#define DIV_SAMPLE_UNDO_MAX_STEPS 100
+
+// the smallest block of the peak pyramid is 2^DIV_SAMPLE_PEAK_SHIFT samples
+#define DIV_SAMPLE_PEAK_SHIFT 5
+// number of levels in the peak pyramid (each one has blocks twice as large as the previous)
+#define DIV_SAMPLE_PEAK_LEVELS 20
 
 enum DivSampleLoopMode: unsigned char {
   DIV_SAMPLE_LOOP_FORWARD=0,
@@ -67,6 +79,10 @@ struct DivSampleHistory {
   bool loop, brrEmphasis, dither;
   DivSampleLoopMode loopMode;
   bool hasSample;
+  // if diff is true, data only holds bytes diffStart to length-diffEnd of the sample data.
+  // the rest is taken from the buffer this step is applied to (diffLength bytes long).
+  bool diff;
+  unsigned int diffStart, diffEnd, diffLength;
   DivSampleHistory(void* d, unsigned int l, unsigned int s, DivSampleDepth de, int r, int cr, int ls, int le, bool lp, bool be, bool di, DivSampleLoopMode lm):
     data((unsigned char*)d),
     length(l),
@@ -80,7 +96,11 @@ struct DivSampleHistory {
     brrEmphasis(be),
     dither(di),
     loopMode(lm),
-    hasSample(true) {}
+    hasSample(true),
+    diff(false),
+    diffStart(0),
+    diffEnd(0),
+    diffLength(0) {}
   DivSampleHistory(DivSampleDepth de, int r, int cr, int ls, int le, bool lp, bool be, bool di, DivSampleLoopMode lm):
     data(NULL),
     length(0),
@@ -94,7 +114,16 @@ struct DivSampleHistory {
     brrEmphasis(be),
     dither(di),
     loopMode(lm),
-    hasSample(false) {}
+    hasSample(false),
+    diff(false),
+    diffStart(0),
+    diffEnd(0),
+    diffLength(0) {}
+  /**
+   * get the amount of memory used by this step.
+   * @return the size in bytes.
+   */
+  size_t getSize();
   ~DivSampleHistory();
 };
 
@@ -144,9 +173,19 @@ struct DivSample {
 
   unsigned int samples;
 
+  // hash of the data and parameters each format was last rendered from
+  unsigned int renderKey[DIV_SAMPLE_DEPTH_MAX];
+  bool renderKeyValid[DIV_SAMPLE_DEPTH_MAX];
+
   FixedQueue<DivSampleHistory*,128> undoHist;
   FixedQueue<DivSampleHistory*,128> redoHist;
 
+  // min/max pyramid of the sample data (in 16-bit scale) for drawing.
+  // each level holds min and max pairs.
+  std::vector<short> peaks[DIV_SAMPLE_PEAK_LEVELS];
+  unsigned int peaksSamples, peaksDirtyStart, peaksDirtyEnd, peaksKey;
+  bool peaks8;
+
   /**
    * put sample data.
    * @param w a SafeWriter.
@@ -157,9 +196,10 @@ struct DivSample {
    * read sample data.
    * @param reader the reader.
    * @param version the format version.
+   * @param metadataOnly if true, only the header is read and no sample memory is allocated.
    * @return a DivDataErrors.
    */
-  DivDataErrors readSampleData(SafeReader& reader, short version);
+  DivDataErrors readSampleData(SafeReader& reader, short version, bool metadataOnly=false);
 
   /**
    * check if sample is loopable.
@@ -304,6 +344,34 @@ struct DivSample {
    */
   unsigned int getCurBufLen();
 
+  /**
+   * mark a range of sample data as changed, so that its peaks are rebuilt on the next getPeak().
+   * edits which go through render() or change the sample count don't need this.
+   * @param start the first changed sample.
+   * @param end the sample after the last changed one.
+   */
+  void invalidatePeaks(unsigned int start=0, unsigned int end=UINT_MAX);
+
+  /**
+   * get the minimum and maximum values of a range of sample data, using the peak pyramid.
+   * values are in 16-bit scale even for 8-bit samples.
+   * @param start the first sample.
+   * @param end the sample after the last one.
+   * @param outMin the minimum value.
+   * @param outMax the maximum value.
+   * @return whether there is any sample in the range.
+   */
+  bool getPeak(unsigned int start, unsigned int end, short& outMin, short& outMax);
+
+  /**
+   * free converted sample data in formats which are not needed.
+   * data in the sample's own depth and 16-bit data are always kept.
+   * @param formatMask the formats to keep.
+   * @param dryRun if true, don't free anything.
+   * @return the amount of memory (which would be) freed in bytes.
+   */
+  size_t freeUnusedFormats(unsigned int formatMask, bool dryRun=false);
+
   /**
    * prepare an undo step for this sample.
    * @param data whether to include sample data.
@@ -312,6 +380,19 @@ struct DivSample {
    */
   DivSampleHistory* prepareUndo(bool data, bool doNotPush=false);
 
+  /**
+   * reduce an undo step to the part of its sample data which differs from the current data.
+   * @param h the undo step. it must be the next one to be applied to this sample.
+   */
+  void compactUndo(DivSampleHistory* h);
+
+  /**
+   * rebuild the full sample data of an undo step reduced by compactUndo().
+   * @param h the undo step. it must be the next one to be applied to this sample.
+   * @return false if the step does not match the current sample data. h is left untouched in that case.
+   */
+  bool expandUndo(DivSampleHistory* h);
+
   /**
    * undo. you may need to call DivEngine::renderSamples afterwards.
    * @warning do not attempt to undo outside of a synchronized block!
@@ -362,7 +443,14 @@ struct DivSample {
     lengthVOX(0),
     lengthMuLaw(0),
     lengthC219(0),
-    samples(0) {
+    samples(0),
+    peaksSamples(0),
+    peaksDirtyStart(0),
+    peaksDirtyEnd(UINT_MAX),
+    peaksKey(0),
+    peaks8(false) {
+    memset(renderKey,0,DIV_SAMPLE_DEPTH_MAX*sizeof(unsigned int));
+    memset(renderKeyValid,0,DIV_SAMPLE_DEPTH_MAX*sizeof(bool));
     for (int i=0; i<DIV_MAX_CHIPS; i++) {
       for (int j=0; j<DIV_MAX_SAMPLE_TYPE; j++) {
         renderOn[j][i]=true;
@@ -18,12 +18,54 @@
  */
 
 #include "engine.h"
+#include "workPool.h"
 #include "../ta-log.h"
 #include "../utfutils.h"
 #include "song.h"
 
 constexpr int MASTER_CLOCK_PREC=(sizeof(void*)==8)?8:0;
 
+void DivVGMExportCache::clear() {
+  if (data!=NULL) {
+    data->finish();
+    delete data;
+    data=NULL;
+  }
+  songRev=0;
+  params="";
+  warnings="";
+}
+
+// the song itself is identified by songRev, which is bumped on every modification.
+// the export parameters and chip core settings are written into a small key.
+String DivEngine::getVGMExportKey(bool* sysToExport, bool loop, int version, bool patternHints, bool directStream, int trailingTicks) {
+  SafeWriter* params=new SafeWriter;
+  params->init();
+  params->writeI(curSubSongIndex);
+  params->writeC(loop);
+  params->writeI(version);
+  params->writeC(patternHints);
+  params->writeC(directStream);
+  params->writeI(trailingTicks);
+  for (int i=0; i<song.systemLen; i++) {
+    params->writeC((sysToExport==NULL)?true:sysToExport[i]);
+  }
+  // emulation cores affect direct stream output
+  for (const std::pair<const String,String>& i: conf.configMap()) {
+    if (i.first.find("Core")==String::npos) continue;
+    params->writeString(i.first,false);
+    params->writeString(i.second,false);
+  }
+  params->writeC(yrw801ROM.data!=NULL);
+  params->writeC(tg100ROM.data!=NULL);
+  params->writeC(mu5ROM.data!=NULL);
+
+  String ret((const char*)params->getFinalBuf(),params->size());
+  params->finish();
+  delete params;
+  return ret;
+}
+
 void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write, int streamOff, double* loopTimer, double* loopFreq, int* loopSample, bool* sampleDir, bool isSecond, int* pendingFreq, int* playingSample, int* setPos, unsigned int* sampleOff8, unsigned int* sampleLen8, size_t bankOffset, bool directStream) {
   unsigned char baseAddr1=isSecond?0xa0:0x50;
   unsigned char baseAddr2=isSecond?0x80:0;
@@ -1119,6 +1161,19 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   stop();
   repeatPattern=false;
   setOrder(0);
+
+  // reuse the previous result if neither the song nor the parameters changed
+  String exportKey=getVGMExportKey(sysToExport,loop,version,patternHints,directStream,trailingTicks);
+  if (vgmCache.data!=NULL && vgmCache.songRev==songRev && vgmCache.params==exportKey) {
+    logI("nothing changed since last VGM export. reusing result.");
+    warnings=vgmCache.warnings;
+    SafeWriter* w=new SafeWriter;
+    w->init();
+    w->write(vgmCache.data->getFinalBuf(),vgmCache.data->size());
+    return w;
+  }
+  vgmCache.clear();
+
   BUSY_BEGIN_SOFT;
   double origRate=got.rate;
   got.rate=44100;
@@ -1226,6 +1281,12 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   std::vector<unsigned int> chipVol;
   std::vector<DivDelayedWrite> delayedWrites[DIV_MAX_CHIPS];
   std::vector<std::pair<int,DivDelayedWrite>> sortedWrites;
+  size_t streamPos[DIV_MAX_CHIPS];
+  struct DivVGMStreamJob {
+    DivDispatch* dispatch;
+    std::vector<DivDelayedWrite>* stream;
+    size_t len;
+  } streamJobs[DIV_MAX_CHIPS];
   std::vector<size_t> tickPos;
   std::vector<int> tickSample;
 
@@ -2518,22 +2579,45 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
     // check whether we need to loop
     int totalWait=cycles>>MASTER_CLOCK_PREC;
     if (directStream) {
-      // render stream of all chips
+      // render stream of all chips in parallel
+      if (renderPool==NULL) {
+        unsigned int howManyThreads=song.systemLen;
+        if (howManyThreads<2) howManyThreads=0;
+        if (howManyThreads>renderPoolThreads) howManyThreads=renderPoolThreads;
+        renderPool=new DivWorkPool(howManyThreads);
+      }
+      size_t streamTotal=0;
+      for (int i=0; i<song.systemLen; i++) {
+        streamJobs[i].dispatch=disCont[i].dispatch;
+        streamJobs[i].stream=&delayedWrites[i];
+        streamJobs[i].len=totalWait;
+        renderPool->push([](void* d) {
+          DivVGMStreamJob* job=(DivVGMStreamJob*)d;
+          job->dispatch->fillStream(*job->stream,44100,job->len);
+        },&streamJobs[i]);
+      }
+      renderPool->wait();
+
+      // each stream is already in order, so merge them instead of sorting.
+      // on equal times the chip with the lowest index goes first.
       for (int i=0; i<song.systemLen; i++) {
-        disCont[i].dispatch->fillStream(delayedWrites[i],44100,totalWait);
-        for (DivDelayedWrite& j: delayedWrites[i]) {
-          sortedWrites.push_back(std::pair<int,DivDelayedWrite>(i,j));
+        streamPos[i]=0;
+        streamTotal+=delayedWrites[i].size();
+      }
+      sortedWrites.reserve(streamTotal);
+      while (sortedWrites.size()<streamTotal) {
+        int next=-1;
+        for (int i=0; i<song.systemLen; i++) {
+          if (streamPos[i]>=delayedWrites[i].size()) continue;
+          if (next<0 || delayedWrites[i][streamPos[i]].time<delayedWrites[next][streamPos[next]].time) next=i;
         }
+        sortedWrites.push_back(std::pair<int,DivDelayedWrite>(next,delayedWrites[next][streamPos[next]++]));
+      }
+      for (int i=0; i<song.systemLen; i++) {
         delayedWrites[i].clear();
       }
 
       if (!sortedWrites.empty()) {
-        // sort if more than one chip
-        if (song.systemLen>1) {
-          std::sort(sortedWrites.begin(),sortedWrites.end(),[](const std::pair<int,DivDelayedWrite>& a, const std::pair<int,DivDelayedWrite>& b) -> bool {
-            return a.second.time<b.second.time;
-          });
-        }
 
         // write it out
         int lastOne=0;
@@ -2716,6 +2800,13 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
 
   logI("%d register writes total.",writeCount);
 
+  vgmCache.songRev=songRev;
+  vgmCache.params=exportKey;
+  vgmCache.warnings=warnings;
+  vgmCache.data=new SafeWriter;
+  vgmCache.data->init();
+  vgmCache.data->write(w->getFinalBuf(),w->size());
+
   BUSY_END;
   return w;
 }
@@ -33,6 +33,20 @@ bool DivEngine::isExporting() {
   return exporting;
 }
 
+bool DivEngine::getExportProgress(double& progress, double& eta) {
+  if (!exporting || exportLength<=0.0 || exportFileCount<1) return false;
+  double songPos=(double)totalSeconds+(double)totalTicks/1000000.0;
+  double fileProgress=MIN(1.0,songPos/exportLength);
+  progress=((double)exportFileCur+fileProgress)/(double)exportFileCount;
+  if (progress<=0.0) {
+    eta=-1.0;
+    return true;
+  }
+  double elapsed=std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now()-exportStartTime).count();
+  eta=elapsed*(1.0-progress)/progress;
+  return true;
+}
+
 #ifdef HAVE_SNDFILE
 void DivEngine::runExportThread() {
   size_t fadeOutSamples=got.rate*exportFadeOut;
@@ -62,7 +76,7 @@ void DivEngine::runExportThread() {
 
       // take control of audio output
       deinitAudioBackend();
-      playSub(false);
+      exportPlaySub();
 
       logI("rendering to file...");
 
@@ -157,7 +171,7 @@ void DivEngine::runExportThread() {
 
       // take control of audio output
       deinitAudioBackend();
-      playSub(false);
+      exportPlaySub();
 
       logI("rendering to files...");
 
@@ -278,12 +292,13 @@ void DivEngine::runExportThread() {
         
         curOrder=0;
         prevOrder=0;
+        exportFileCur=i;
         curFadeOutSample=0;
         lastLoopPos=-1;
         totalLoops=0;
         isFadingOut=false;
         remainingLoops=-1;
-        playSub(false);
+        exportPlaySub();
 
         while (playing) {
           size_t total=0;
@@ -368,6 +383,14 @@ void DivEngine::runExportThread() {
 }
 #endif
 
+void DivEngine::exportPlaySub() {
+  if (exportFromStream) {
+    if (startCommandStream()) return;
+    logW("falling back to pattern playback.");
+  }
+  playSub(false);
+}
+
 bool DivEngine::shallSwitchCores() {
   // TODO: detect whether we should
   return true;
@@ -399,6 +422,14 @@ bool DivEngine::saveAudio(const char* path, int loops, DivAudioExportModes mode,
   setOrder(0);
   remainingLoops=-1;
 
+  exportFromStream=false;
+  if (precompiledPlayback) {
+    exportFromStream=compileCommandStream();
+    if (!exportFromStream) {
+      logW("could not compile command stream! rendering from patterns.");
+    }
+  }
+
   if (shallSwitchCores()) {
     bool isMutedBefore[DIV_MAX_CHANS];
     memcpy(isMutedBefore,isMuted,DIV_MAX_CHANS*sizeof(bool));
@@ -413,6 +444,17 @@ bool DivEngine::saveAudio(const char* path, int loops, DivAudioExportModes mode,
   }
 
   exportLoopCount=loops;
+
+  // estimate the length of the export for progress reporting
+  DivSongTimestamps ts=calcSongTimestamps(curSubSongIndex);
+  exportLength=ts.totalSeconds;
+  if (ts.loopOrder>=0) {
+    exportLength+=(ts.totalSeconds-ts.loopStart)*MAX(0,loops-1)+fadeOutTime;
+  }
+  exportFileCur=0;
+  exportFileCount=(exportMode==DIV_EXPORT_MODE_MANY_CHAN)?chans:1;
+  exportStartTime=std::chrono::steady_clock::now();
+
   exportThread=new std::thread(_runExportThread,this);
   return true;
 #endif
@@ -433,6 +475,7 @@ bool DivEngine::haltAudioFile() {
 }
 
 void DivEngine::finishAudioFile() {
+  exportFromStream=false;
   if (shallSwitchCores()) {
     bool isMutedBefore[DIV_MAX_CHANS];
     memcpy(isMutedBefore,isMuted,DIV_MAX_CHANS*sizeof(bool));
@@ -21,6 +21,7 @@
 #include "../ta-log.h"
 #include "../utfutils.h"
 #include "song.h"
+#include <zlib.h>
 
 DivZSM::DivZSM() {
   w=NULL;
@@ -57,6 +58,7 @@ void DivZSM::init(unsigned int rate) {
   // Initialize YM/PSG states
   memset(&ymState,-1,sizeof(ymState));
   memset(&psgState,-1,sizeof(psgState));
+  psgDirty=0;
   // Initialize PCM states
   pcmRateCache=-1;
   pcmCtrlRVCache=-1;
@@ -68,6 +70,7 @@ void DivZSM::init(unsigned int rate) {
   psgMask=0;
   // Optimize writes
   optimize=true;
+  memset(&stats,0,sizeof(stats));
 }
 
 int DivZSM::getoffset() {
@@ -115,6 +118,10 @@ void DivZSM::writeYM(unsigned char a, unsigned char v) {
     if (a==0x1a) a=0x19;
     ymwrites.push_back(DivRegWrite(a,v));
     numWrites++;
+  } else if (!writeit) {
+    stats.ymInactive++;
+  } else {
+    stats.ymDupes++;
   }
 }
 
@@ -139,8 +146,13 @@ void DivZSM::writePSG(unsigned char a, unsigned char v) {
       // No need to preserve state here because the next write that
       // selects pulse will also set the pulse width in this register
       v&=0xc0;
+      stats.psgPulseMasked++;
     }
   }
+  // a pending write which gets replaced before being flushed is coalesced
+  if (psgState[psg_NEW][a]!=psgState[psg_PREV][a] && psgState[psg_NEW][a]!=v) {
+    stats.psgCoalesced++;
+  }
   if (psgState[psg_PREV][a]==v) {
     if (psgState[psg_NEW][a]!=v) {
       // NEW value is being reset to the same as PREV value
@@ -155,6 +167,11 @@ void DivZSM::writePSG(unsigned char a, unsigned char v) {
     }
   }
   psgState[psg_NEW][a]=v;
+  if (psgState[psg_PREV][a]==v) {
+    psgDirty&=~(1ULL<<a);
+  } else {
+    psgDirty|=1ULL<<a;
+  }
   // mark channel as used in the psgMask if volume is set>0.
   if ((a&3)==2 && (v&0x3f)) psgMask|=(1<<(a>>2));
 }
@@ -202,6 +219,7 @@ void DivZSM::setLoopPoint() {
   w->seek(loopOffset,SEEK_SET);
   // reset the PSG shadow and write cache
   memset(&psgState,-1,sizeof(psgState));
+  psgDirty=0;
   // reset the PCM caches that would inhibit dupes
   pcmRateCache=-1;
   pcmCtrlRVCache=-1;
@@ -231,6 +249,7 @@ SafeWriter* DivZSM::finish() {
   if (pcmInsts.size()>256) {
     logE("ZSM: more than the maximum number of PCM instruments exist. Skipping PCM export entirely.");
     pcmData.clear();
+    pcmBlobs.clear();
     pcmInsts.clear();
   } else if (pcmData.size()) { // if exists, write PCM instruments and blob to the end of file
     unsigned int pcmOff=w->tell();
@@ -266,10 +285,9 @@ SafeWriter* DivZSM::finish() {
       w->writeS(0);
       i++;
     }
-    for (unsigned char& c: pcmData) {
-      w->writeC(c);
-    }
+    w->write(pcmData.data(),pcmData.size());
     pcmData.clear();
+    pcmBlobs.clear();
     // update PCM offset in file
     w->seek(0x06,SEEK_SET);
     w->writeC((unsigned char)pcmOff&0xff);
@@ -280,21 +298,59 @@ SafeWriter* DivZSM::finish() {
   w->seek(0x09,SEEK_SET);
   w->writeC((unsigned char)(ymMask&0xff));
   w->writeS((short)(psgMask&0xffff));
+  logStats();
   return w;
 }
 
+unsigned int DivZSM::findPCM() {
+  // look for an identical blob by content hash first. this is the common
+  // case (the same sample being triggered over and over again).
+  unsigned int hash=crc32(0,pcmCache.data(),pcmCache.size());
+  auto range=pcmBlobs.equal_range(hash);
+  for (auto i=range.first; i!=range.second; i++) {
+    if (i->second.length!=pcmCache.size()) continue;
+    if (memcmp(&pcmData[i->second.offset],pcmCache.data(),pcmCache.size())==0) {
+      stats.pcmReused++;
+      stats.pcmBytesSaved+=pcmCache.size();
+      return i->second.offset;
+    }
+  }
+  // otherwise the blob may still be contained within previous data
+  std::vector<unsigned char>::iterator it;
+  it=std::search(pcmData.begin(),pcmData.end(),pcmCache.begin(),pcmCache.end());
+  S_pcmBlob blob;
+  blob.offset=std::distance(pcmData.begin(),it);
+  blob.length=pcmCache.size();
+  if (it==pcmData.end()) {
+    pcmData.insert(pcmData.end(),pcmCache.begin(),pcmCache.end());
+  } else {
+    stats.pcmReused++;
+    stats.pcmBytesSaved+=pcmCache.size();
+  }
+  pcmBlobs.emplace(hash,blob);
+  return blob.offset;
+}
+
+void DivZSM::logStats() {
+  logI("ZSM: YM writes suppressed: %d duplicate, %d to inactive channels",stats.ymDupes,stats.ymInactive);
+  logI("ZSM: PSG writes coalesced: %d, pulse widths masked: %d",stats.psgCoalesced,stats.psgPulseMasked);
+  logI("ZSM: most YM writes in a tick: %d (%d ticks over the limit of %d)",stats.ymMaxPerTick,stats.ymSplitTicks,ZSM_YM_MAX_WRITES);
+  logI("ZSM: PCM blobs reused: %d (%d bytes saved)",stats.pcmReused,(int)stats.pcmBytesSaved);
+}
+
 void DivZSM::flushWrites() {
   logD("ZSM: flushWrites.... numwrites=%d ticks=%d ymwrites=%d pcmMeta=%d pcmCache=%d pcmData=%d syncCache=%d",numWrites,ticks,ymwrites.size(),pcmMeta.size(),pcmCache.size(),pcmData.size(),syncCache.size());
   if (numWrites==0) return;
   bool hasFlushed=false;
-  for (unsigned char i=0; i<64; i++) {
-    if (psgState[psg_NEW][i]==psgState[psg_PREV][i]) continue;
+  for (unsigned char i=0; psgDirty && i<64; i++) {
+    if (!(psgDirty&(1ULL<<i))) continue;
     // if optimize=true, suppress writes to PSG voices that are not audible (volume=0 or R+L=0)
     // ZSMKit has a feature that can benefit from having silent channels
     // updated, so this is something that can be toggled off or on for export
     if (optimize && (i&3)!=2 && (psgState[psg_NEW][(i&0x3c)+2]&0x3f)==0) continue; // vol
     if (optimize && (i&3)!=2 && (psgState[psg_NEW][(i&0x3c)+2]&0xc0)==0) continue; // R+L
     psgState[psg_PREV][i]=psgState[psg_NEW][i];
+    psgDirty&=~(1ULL<<i);
     if (!hasFlushed) {
       flushTicks();
       hasFlushed=true;
@@ -302,6 +358,8 @@ void DivZSM::flushWrites() {
     w->writeC(i);
     w->writeC(psgState[psg_NEW][i]);
   }
+  if ((int)ymwrites.size()>stats.ymMaxPerTick) stats.ymMaxPerTick=ymwrites.size();
+  if (ymwrites.size()>ZSM_YM_MAX_WRITES) stats.ymSplitTicks++;
   int n=0; // n=completed YM writes. used to determine when to write the CMD byte...
   for (DivRegWrite& write: ymwrites) {
     if (!hasFlushed) {
@@ -371,14 +429,9 @@ void DivZSM::flushWrites() {
     // check to see if the most recent received blob matches any of the previous data
     // and reuse it if there is a match, otherwise append the cache to the rest of
     // the PCM data
-    std::vector<unsigned char>::iterator it;
-    it=std::search(pcmData.begin(),pcmData.end(),pcmCache.begin(),pcmCache.end());
-    pcmOff=std::distance(pcmData.begin(),it);
+    pcmOff=findPCM();
     pcmLen=pcmCache.size();
     logD("ZSM: pcmOff: %d pcmLen: %d",pcmOff,pcmLen);
-    if (it==pcmData.end()) {
-      pcmData.insert(pcmData.end(),pcmCache.begin(),pcmCache.end());
-    }
     pcmCache.clear();
     extCmd0Len+=2;
     // search for a matching PCM instrument definition
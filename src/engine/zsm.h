@@ -24,6 +24,7 @@
 #include "safeWriter.h"
 #include "dispatch.h"
 #include <stdlib.h>
+#include <unordered_map>
 
 #define ZSM_HEADER_SIZE 16
 #define ZSM_VERSION 1
@@ -50,9 +51,21 @@ class DivZSM {
       unsigned int offset, length, loopPoint;
       bool isLooped;
     };
+    struct S_pcmBlob {
+      unsigned int offset, length;
+    };
+    // export statistics, reported on finish()
+    struct S_stats {
+      int ymDupes, ymInactive, ymMaxPerTick, ymSplitTicks;
+      int psgCoalesced, psgPulseMasked;
+      int pcmReused;
+      size_t pcmBytesSaved;
+    };
     SafeWriter* w;
     int ymState[ym_STATES][256];
     int psgState[psg_STATES][64];
+    // bit set for every PSG register whose NEW value differs from PREV
+    unsigned long long psgDirty;
     int pcmRateCache;
     int pcmCtrlRVCache;
     int pcmCtrlDCCache;
@@ -63,6 +76,8 @@ class DivZSM {
     std::vector<unsigned char> pcmData;
     std::vector<unsigned char> pcmCache;
     std::vector<S_pcmInst> pcmInsts;
+    // content hash of every PCM blob stored in pcmData
+    std::unordered_multimap<unsigned int,S_pcmBlob> pcmBlobs;
     std::vector<DivRegWrite> syncCache;
     int loopOffset;
     int numWrites;
@@ -71,6 +86,7 @@ class DivZSM {
     int ymMask;
     int psgMask;
     bool optimize;
+    S_stats stats;
   public:
     DivZSM();
     ~DivZSM();
@@ -87,6 +103,8 @@ class DivZSM {
   private:
     void flushWrites();
     void flushTicks();
+    unsigned int findPCM();
+    void logStats();
 };
 
 #endif
@@ -116,6 +116,98 @@ void FurnaceGUI::calcChanOsc() {
   }
 }
 
+// copy the samples that a pitch analysis needs, so that it doesn't touch the oscilloscope buffer
+// (which may go away while the analysis is running).
+static void snapChanOsc(short* dest, const short* ring, unsigned short start, int len) {
+  int i=0;
+  while (i<len) {
+    unsigned short pos=start+i;
+    int run=MIN(len-i,65536-(int)pos);
+    memcpy(&dest[i],&ring[pos],run*sizeof(short));
+    i+=run;
+  }
+}
+
+// a channel's region of the oscilloscope texture
+struct ChanOscRaster {
+  DivDispatchOscBuffer* buf;
+  unsigned int* dest;
+  int stride, w, h;
+  int displaySize;
+  unsigned short needle;
+  float amp, lineWidth;
+  bool flat;
+};
+
+// rasterize a channel's waveform as white with coverage in alpha, so that it can be tinted when drawn.
+// each column is the min/max span of the samples under it (joined with the previous column).
+static void rasterChanOsc(void* r_v) {
+  ChanOscRaster* r=(ChanOscRaster*)r_v;
+  const float halfWidth=r->lineWidth*0.5f;
+  const float h=r->h;
+
+  for (int i=0; i<r->h; i++) {
+    memset(&r->dest[i*r->stride],0,r->w*sizeof(unsigned int));
+  }
+
+  float dcOff=0.0f;
+  if (!r->flat) {
+    short minLevel=32767;
+    short maxLevel=-32768;
+    for (int i=0; i<r->w; i++) {
+      short y=r->buf->data[(unsigned short)(r->needle+(i*r->displaySize/r->w))];
+      if (minLevel>y) minLevel=y;
+      if (maxLevel<y) maxLevel=y;
+    }
+    dcOff=((float)minLevel+(float)maxLevel)*0.5f/32768.0f;
+  }
+
+  float lastY=h*0.5f;
+  for (int i=0; i<r->w; i++) {
+    float top=h*0.5f;
+    float bottom=h*0.5f;
+    if (!r->flat) {
+      int start=(i*r->displaySize)/r->w;
+      int end=((i+1)*r->displaySize)/r->w;
+      if (end<=start) end=start+1;
+      short colMin=32767;
+      short colMax=-32768;
+      short last=0;
+      // don't look at more than 32 samples per column
+      int step=1+((end-start)>>5);
+      for (int j=start; j<end; j+=step) {
+        last=r->buf->data[(unsigned short)(r->needle+j)];
+        if (colMin>last) colMin=last;
+        if (colMax<last) colMax=last;
+      }
+      float yMax=CLAMP((float)colMax/32768.0f-dcOff,-0.5f,0.5f)*r->amp;
+      float yMin=CLAMP((float)colMin/32768.0f-dcOff,-0.5f,0.5f)*r->amp;
+      float yLast=CLAMP((float)last/32768.0f-dcOff,-0.5f,0.5f)*r->amp;
+      top=(0.5f-yMax)*h;
+      bottom=(0.5f-yMin)*h;
+      if (i>0) {
+        if (top>lastY) top=lastY;
+        if (bottom<lastY) bottom=lastY;
+      }
+      lastY=(0.5f-yLast)*h;
+    }
+    top-=halfWidth;
+    bottom+=halfWidth;
+
+    int y0=floor(top);
+    int y1=ceil(bottom);
+    if (y0<0) y0=0;
+    if (y1>r->h) y1=r->h;
+    unsigned int* col=&r->dest[i];
+    for (int j=y0; j<y1; j++) {
+      float cover=MIN(bottom,(float)(j+1))-MAX(top,(float)j);
+      if (cover<=0.0f) continue;
+      if (cover>1.0f) cover=1.0f;
+      col[j*r->stride]=0xffffff|((unsigned int)(cover*255.0f)<<IM_COL32_A_SHIFT);
+    }
+  }
+}
+
 void FurnaceGUI::drawChanOsc() {
   if (nextWindow==GUI_WINDOW_CHAN_OSC) {
     chanOscOpen=true;
@@ -208,6 +300,7 @@ void FurnaceGUI::drawChanOsc() {
           if (chanOscGradTex!=NULL) {
             if (updateChanOscGradTex) {
               chanOscGrad.render();
+              texUpdates++;
               if (rend->updateTexture(chanOscGradTex,chanOscGrad.grad.get(),chanOscGrad.width*4)) {
                 updateChanOscGradTex=false;
               } else {
@@ -362,7 +455,11 @@ void FurnaceGUI::drawChanOsc() {
       }
     } else {
       ImGui::PushStyleVar(ImGuiStyleVar_CellPadding,ImVec2(0.0f,0.0f));
+      float availX=ImGui::GetContentRegionAvail().x;
       float availY=ImGui::GetContentRegionAvail().y;
+      ImVec2 oscOrigin=ImGui::GetCursorScreenPos();
+      oscOrigin.x=floor(oscOrigin.x);
+      oscOrigin.y=floor(oscOrigin.y);
       if (ImGui::BeginTable("ChanOsc",chanOscCols,ImGuiTableFlags_Borders|ImGuiTableFlags_NoClip)) {
         std::vector<DivDispatchOscBuffer*> oscBufs;
         std::vector<ChanOscStatus*> oscFFTs;
@@ -379,6 +476,37 @@ void FurnaceGUI::drawChanOsc() {
           chanOscWorkPool=new DivWorkPool(settings.chanOscThreads);
         }
 
+        // check texture
+        // the texture covers the entire table, and each channel is rasterized into its own region.
+        bool useTex=(settings.chanOscTexture && !debugFFT);
+        if (useTex) {
+          int texW=ceil(availX);
+          int texH=ceil(availY);
+          if (chanOscTex==NULL || chanOscTexW!=texW || chanOscTexH!=texH) {
+            if (chanOscTex!=NULL) {
+              rend->destroyTexture(chanOscTex);
+              chanOscTex=NULL;
+            }
+            if (chanOscTexData!=NULL) {
+              delete[] chanOscTexData;
+              chanOscTexData=NULL;
+            }
+            if (texW>=1 && texH>=1) {
+              logD("recreating chan osc texture.");
+              chanOscTex=rend->createTexture(true,texW,texH);
+              chanOscTexW=texW;
+              chanOscTexH=texH;
+              if (chanOscTex==NULL) {
+                logE("error while creating chan osc texture! %s",SDL_GetError());
+              } else {
+                chanOscTexData=new unsigned int[texW*texH];
+                memset(chanOscTexData,0,texW*texH*sizeof(unsigned int));
+              }
+            }
+          }
+          if (chanOscTex==NULL) useTex=false;
+        }
+
         // fill buffers
         for (int i=0; i<chans; i++) {
           DivDispatchOscBuffer* buf=e->getOscBuffer(i);
@@ -389,7 +517,11 @@ void FurnaceGUI::drawChanOsc() {
           }
         }
 
+        // wait for the analysis started on the previous frame
+        chanOscWorkPool->wait();
+
         // process
+        std::vector<ChanOscStatus*> analyze;
         for (size_t i=0; i<oscBufs.size(); i++) {
           ChanOscStatus* fft_=oscFFTs[i];
 
@@ -421,115 +553,14 @@ void FurnaceGUI::drawChanOsc() {
               }
             }
 
+            // only analyze again if the buffer has moved or the settings have changed
             if (fft_->ready && e->isRunning()) {
-              fft_->windowSize=chanOscWindowSize;
-              fft_->waveCorr=chanOscWaveCorr;
-              chanOscWorkPool->push([](void* fft_v) {
-                ChanOscStatus* fft=(ChanOscStatus*)fft_v;
-                DivDispatchOscBuffer* buf=fft->relatedBuf;
-
-                // the STRATEGY
-                // 1. FFT of windowed signal
-                // 2. inverse FFT of auto-correlation
-                // 3. find size of one period
-                // 4. DFT of the fundamental of ONE PERIOD
-                // 5. now we can get phase information
-                //
-                // I have a feeling this could be simplified to two FFTs or even one...
-                // if you know how, please tell me
-
-                // initialization
-                double phase=0.0;
-                int displaySize=(float)(buf->rate)*(fft->windowSize/1000.0f);
-                fft->loudEnough=false;
-                fft->needle=buf->needle;
-
-                // first FFT
-                for (int j=0; j<FURNACE_FFT_SIZE; j++) {
-                  fft->inBuf[j]=(double)buf->data[(unsigned short)(fft->needle-displaySize*2+((j*displaySize*2)/(FURNACE_FFT_SIZE)))]/32768.0;
-                  if (fft->inBuf[j]>0.001 || fft->inBuf[j]<-0.001) fft->loudEnough=true;
-                  fft->inBuf[j]*=0.55-0.45*cos(M_PI*(double)j/(double)(FURNACE_FFT_SIZE>>1));
-                }
-
-                // only proceed if not quiet
-                if (fft->loudEnough) {
-                  fftw_execute(fft->plan);
-
-                  // auto-correlation and second FFT
-                  for (int j=0; j<FURNACE_FFT_SIZE; j++) {
-                    fft->outBuf[j][0]/=FURNACE_FFT_SIZE;
-                    fft->outBuf[j][1]/=FURNACE_FFT_SIZE;
-                    fft->outBuf[j][0]=fft->outBuf[j][0]*fft->outBuf[j][0]+fft->outBuf[j][1]*fft->outBuf[j][1];
-                    fft->outBuf[j][1]=0;
-                  }
-                  fft->outBuf[0][0]=0;
-                  fft->outBuf[0][1]=0;
-                  fft->outBuf[1][0]=0;
-                  fft->outBuf[1][1]=0;
-                  fftw_execute(fft->planI);
-
-                  // window
-                  for (int j=0; j<(FURNACE_FFT_SIZE>>1); j++) {
-                    fft->corrBuf[j]*=1.0-((double)j/(double)(FURNACE_FFT_SIZE<<1));
-                  }
-
-                  // find size of period
-                  double waveLenCandL=DBL_MAX;
-                  double waveLenCandH=DBL_MIN;
-                  fft->waveLen=FURNACE_FFT_SIZE-1;
-                  fft->waveLenBottom=0;
-                  fft->waveLenTop=0;
-
-                  // find lowest point
-                  for (int j=(FURNACE_FFT_SIZE>>2); j>2; j--) {
-                    if (fft->corrBuf[j]<waveLenCandL) {
-                      waveLenCandL=fft->corrBuf[j];
-                      fft->waveLenBottom=j;
-                    }
-                  }
-                  
-                  // find highest point
-                  for (int j=(FURNACE_FFT_SIZE>>1)-1; j>fft->waveLenBottom; j--) {
-                    if (fft->corrBuf[j]>waveLenCandH) {
-                      waveLenCandH=fft->corrBuf[j];
-                      fft->waveLen=j;
-                    }
-                  }
-                  fft->waveLenTop=fft->waveLen;
-
-                  // did we find the period size?
-                  if (fft->waveLen<(FURNACE_FFT_SIZE-32)) {
-                    // we got pitch
-                    fft->pitch=pow(1.0-(fft->waveLen/(double)(FURNACE_FFT_SIZE>>1)),4.0);
-                    
-                    fft->waveLen*=(double)displaySize*2.0/(double)FURNACE_FFT_SIZE;
-
-                    // DFT of one period (x_1)
-                    double dft[2];
-                    dft[0]=0.0;
-                    dft[1]=0.0;
-                    for (int j=fft->needle-1-(displaySize>>1)-(int)fft->waveLen, k=0; k<fft->waveLen; j++, k++) {
-                      double one=((double)buf->data[j&0xffff]/32768.0);
-                      double two=(double)k*(-2.0*M_PI)/fft->waveLen;
-                      dft[0]+=one*cos(two);
-                      dft[1]+=one*sin(two);
-                    }
-
-                    // calculate and lock into phase
-                    phase=(0.5+(atan2(dft[1],dft[0])/(2.0*M_PI)));
-
-                    if (fft->waveCorr) {
-                      fft->needle-=(phase+(fft->phaseOff*2))*fft->waveLen;
-                    }
-                  }
-                }
-
-                fft->needle-=displaySize;
-              },fft_);
+              if (fft_->inNeedle!=fft_->relatedBuf->needle || fft_->windowSize!=chanOscWindowSize || fft_->waveCorr!=chanOscWaveCorr || fft_->lastPhaseOff!=fft_->phaseOff || centerSettingReset) {
+                analyze.push_back(fft_);
+              }
             }
           }
         }
-        chanOscWorkPool->wait();
 
         // 0: none
         // 1: sqrt(chans)
@@ -551,6 +582,9 @@ void FurnaceGUI::drawChanOsc() {
         
         int rows=(oscBufs.size()+(chanOscCols-1))/chanOscCols;
 
+        std::vector<ChanOscRaster> rasters;
+        rasters.reserve(oscBufs.size());
+
         // render
         for (size_t i=0; i<oscBufs.size(); i++) {
           if (i%chanOscCols==0) ImGui::TableNextRow();
@@ -583,7 +617,45 @@ void FurnaceGUI::drawChanOsc() {
 
             ImGui::ItemSize(size,style.FramePadding.y);
             if (ImGui::ItemAdd(rect,ImGui::GetID("chOscDisplay"))) {
-              if (!e->isRunning()) {
+              ImVec2 texMin, texMax, texUV0, texUV1;
+              bool texReady=false;
+              if (useTex) {
+                int rx=floor(inRect.Min.x-oscOrigin.x);
+                int ry=floor(inRect.Min.y-oscOrigin.y);
+                int rw=inRect.Max.x-inRect.Min.x;
+                int rh=inRect.Max.y-inRect.Min.y;
+                if (rx<0) {
+                  rw+=rx;
+                  rx=0;
+                }
+                if (ry<0) {
+                  rh+=ry;
+                  ry=0;
+                }
+                if (rx+rw>chanOscTexW) rw=chanOscTexW-rx;
+                if (ry+rh>chanOscTexH) rh=chanOscTexH-ry;
+                if (rw>0 && rh>0) {
+                  rasters.push_back(ChanOscRaster());
+                  ChanOscRaster& r=rasters.back();
+                  r.buf=buf;
+                  r.dest=&chanOscTexData[rx+ry*chanOscTexW];
+                  r.stride=chanOscTexW;
+                  r.w=rw;
+                  r.h=rh;
+                  r.displaySize=(float)(buf->rate)*(chanOscWindowSize/1000.0f);
+                  r.needle=fft->needle;
+                  r.amp=chanOscAmplify;
+                  r.lineWidth=dpiScale;
+                  r.flat=!e->isRunning();
+                  chanOscWorkPool->push(rasterChanOsc,&r);
+
+                  texMin=ImVec2(oscOrigin.x+rx,oscOrigin.y+ry);
+                  texMax=ImVec2(texMin.x+rw,texMin.y+rh);
+                  texUV0=ImVec2((float)rx/(float)chanOscTexW,(float)ry/(float)chanOscTexH);
+                  texUV1=ImVec2((float)(rx+rw)/(float)chanOscTexW,(float)(ry+rh)/(float)chanOscTexH);
+                  texReady=true;
+                }
+              } else if (!e->isRunning()) {
                 for (unsigned short j=0; j<precision; j++) {
                   float x=(float)j/(float)precision;
                   waveform[j]=ImLerp(inRect.Min,inRect.Max,ImVec2(x,0.5f));
@@ -666,7 +738,12 @@ void FurnaceGUI::drawChanOsc() {
 
               //ImDrawListFlags prevFlags=dl->Flags;
               //dl->Flags&=~(ImDrawListFlags_AntiAliasedLines|ImDrawListFlags_AntiAliasedLinesUseTex);
-              dl->AddPolyline(waveform,precision,color,ImDrawFlags_None,dpiScale);
+              if (useTex) {
+                // the texture is uploaded once every channel has been rasterized
+                if (texReady) dl->AddImage(rend->getTextureID(chanOscTex),texMin,texMax,texUV0,texUV1,color);
+              } else {
+                dl->AddPolyline(waveform,precision,color,ImDrawFlags_None,dpiScale);
+              }
               //dl->Flags=prevFlags;
 
               if (!chanOscTextFormat.empty()) {
@@ -780,6 +857,137 @@ void FurnaceGUI::drawChanOsc() {
             }
           }
         }
+
+        // upload texture
+        if (useTex) {
+          chanOscWorkPool->wait();
+          texUpdates++;
+          if (!rend->updateTexture(chanOscTex,chanOscTexData,chanOscTexW*4)) {
+            logE("error while updating chan osc texture!");
+          }
+        }
+
+        // start pitch analysis
+        // it runs while the rest of the frame is drawn, and the results are picked up on the next frame.
+        for (ChanOscStatus* fft_: analyze) {
+          DivDispatchOscBuffer* buf=fft_->relatedBuf;
+          int displaySize=(float)(buf->rate)*(chanOscWindowSize/1000.0f);
+          if (displaySize<1) displaySize=1;
+          if (fft_->snapCap<displaySize*2) {
+            if (fft_->snapBuf!=NULL) delete[] fft_->snapBuf;
+            fft_->snapCap=displaySize*2;
+            fft_->snapBuf=new short[fft_->snapCap];
+          }
+          fft_->snapLen=displaySize*2;
+          fft_->inNeedle=buf->needle;
+          fft_->windowSize=chanOscWindowSize;
+          fft_->waveCorr=chanOscWaveCorr;
+          fft_->lastPhaseOff=fft_->phaseOff;
+          snapChanOsc(fft_->snapBuf,buf->data,fft_->inNeedle-fft_->snapLen,fft_->snapLen);
+          chanOscWorkPool->push([](void* fft_v) {
+            ChanOscStatus* fft=(ChanOscStatus*)fft_v;
+
+            // the STRATEGY
+            // 1. FFT of windowed signal
+            // 2. inverse FFT of auto-correlation
+            // 3. find size of one period
+            // 4. DFT of the fundamental of ONE PERIOD
+            // 5. now we can get phase information
+            //
+            // I have a feeling this could be simplified to two FFTs or even one...
+            // if you know how, please tell me
+
+            // initialization
+            double phase=0.0;
+            // snapBuf holds the last displaySize*2 samples before inNeedle
+            int displaySize=fft->snapLen>>1;
+            fft->loudEnough=false;
+            fft->needle=fft->inNeedle;
+
+            // first FFT
+            for (int j=0; j<FURNACE_FFT_SIZE; j++) {
+              fft->inBuf[j]=(double)fft->snapBuf[(j*displaySize*2)/(FURNACE_FFT_SIZE)]/32768.0;
+              if (fft->inBuf[j]>0.001 || fft->inBuf[j]<-0.001) fft->loudEnough=true;
+              fft->inBuf[j]*=0.55-0.45*cos(M_PI*(double)j/(double)(FURNACE_FFT_SIZE>>1));
+            }
+
+            // only proceed if not quiet
+            if (fft->loudEnough) {
+              fftw_execute(fft->plan);
+
+              // auto-correlation and second FFT
+              for (int j=0; j<FURNACE_FFT_SIZE; j++) {
+                fft->outBuf[j][0]/=FURNACE_FFT_SIZE;
+                fft->outBuf[j][1]/=FURNACE_FFT_SIZE;
+                fft->outBuf[j][0]=fft->outBuf[j][0]*fft->outBuf[j][0]+fft->outBuf[j][1]*fft->outBuf[j][1];
+                fft->outBuf[j][1]=0;
+              }
+              fft->outBuf[0][0]=0;
+              fft->outBuf[0][1]=0;
+              fft->outBuf[1][0]=0;
+              fft->outBuf[1][1]=0;
+              fftw_execute(fft->planI);
+
+              // window
+              for (int j=0; j<(FURNACE_FFT_SIZE>>1); j++) {
+                fft->corrBuf[j]*=1.0-((double)j/(double)(FURNACE_FFT_SIZE<<1));
+              }
+
+              // find size of period
+              double waveLenCandL=DBL_MAX;
+              double waveLenCandH=DBL_MIN;
+              fft->waveLen=FURNACE_FFT_SIZE-1;
+              fft->waveLenBottom=0;
+              fft->waveLenTop=0;
+
+              // find lowest point
+              for (int j=(FURNACE_FFT_SIZE>>2); j>2; j--) {
+                if (fft->corrBuf[j]<waveLenCandL) {
+                  waveLenCandL=fft->corrBuf[j];
+                  fft->waveLenBottom=j;
+                }
+              }
+  
+              // find highest point
+              for (int j=(FURNACE_FFT_SIZE>>1)-1; j>fft->waveLenBottom; j--) {
+                if (fft->corrBuf[j]>waveLenCandH) {
+                  waveLenCandH=fft->corrBuf[j];
+                  fft->waveLen=j;
+                }
+              }
+              fft->waveLenTop=fft->waveLen;
+
+              // did we find the period size?
+              if (fft->waveLen<(FURNACE_FFT_SIZE-32)) {
+                // we got pitch
+                fft->pitch=pow(1.0-(fft->waveLen/(double)(FURNACE_FFT_SIZE>>1)),4.0);
+    
+                fft->waveLen*=(double)displaySize*2.0/(double)FURNACE_FFT_SIZE;
+
+                // DFT of one period (x_1)
+                double dft[2];
+                dft[0]=0.0;
+                dft[1]=0.0;
+                for (int j=displaySize*2-1-(displaySize>>1)-(int)fft->waveLen, k=0; k<fft->waveLen; j++, k++) {
+                  if (j<0 || j>=fft->snapLen) continue;
+                  double one=((double)fft->snapBuf[j]/32768.0);
+                  double two=(double)k*(-2.0*M_PI)/fft->waveLen;
+                  dft[0]+=one*cos(two);
+                  dft[1]+=one*sin(two);
+                }
+
+                // calculate and lock into phase
+                phase=(0.5+(atan2(dft[1],dft[0])/(2.0*M_PI)));
+
+                if (fft->waveCorr) {
+                  fft->needle-=(phase+(fft->lastPhaseOff*2))*fft->waveLen;
+                }
+              }
+            }
+
+            fft->needle-=displaySize;
+          },fft_);
+        }
         ImGui::EndTable();
 
         if (ImGui::IsItemClicked(ImGuiMouseButton_Right)) {
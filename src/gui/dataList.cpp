@@ -169,12 +169,176 @@ void FurnaceGUI::insListItem(int i, int dir, int asset) {
   ImGui::PopStyleColor();
 }
 
-void FurnaceGUI::waveListItem(int i, float* wavePreview, int dir, int asset) {
-  DivWavetable* wave=e->song.wave[i];
+// wave list thumbnails are rasterized into cells of a single atlas texture.
+// a cell is only redrawn when the contents of its wavetable change.
+// cells are as large as the list items, so that they are drawn 1:1.
+// larger items are plotted directly instead.
+#define WAVE_THUMB_MAX_W 768
+#define WAVE_THUMB_MAX_H 48
+#define WAVE_THUMB_TEX_MAX 4096
+// maximum number of cells rasterized per frame
+#define WAVE_THUMB_MAX_UPDATES 64
+
+static uint64_t waveThumbHash(DivWavetable* wave) {
+  uint64_t ret=14695981039346656037ULL;
+  ret=(ret^(unsigned int)wave->len)*1099511628211ULL;
+  ret=(ret^(unsigned int)wave->max)*1099511628211ULL;
   for (int i=0; i<wave->len; i++) {
-    wavePreview[i]=wave->data[i];
+    ret=(ret^(unsigned int)wave->data[i])*1099511628211ULL;
+  }
+  // 0 means "not rasterized"
+  if (ret==0) ret=1;
+  return ret;
+}
+
+void FurnaceGUI::prepareWaveThumbs() {
+  waveThumbPending.clear();
+  if (rend==NULL) return;
+
+  // size the atlas after the items drawn last frame
+  int cellW=waveThumbWantW;
+  int cellH=waveThumbWantH;
+  if (cellW<1 || cellH<1 || cellW>WAVE_THUMB_MAX_W || cellH>WAVE_THUMB_MAX_H) return;
+  int cols=MIN(256,WAVE_THUMB_TEX_MAX/cellW);
+  int rows=(MAX(1,(int)e->song.wave.size())+cols-1)/cols;
+  if (waveThumbTex!=NULL && cellW==waveThumbW && cellH==waveThumbH && rows<=waveThumbRows) return;
+
+  if (waveThumbTex!=NULL) {
+    rend->destroyTexture(waveThumbTex);
+    waveThumbTex=NULL;
+  }
+  if (waveThumbData!=NULL) {
+    delete[] waveThumbData;
+    waveThumbData=NULL;
+  }
+  waveThumbW=cellW;
+  waveThumbH=cellH;
+  waveThumbCols=cols;
+  waveThumbRows=rows;
+
+  logD("creating wave thumbnail texture (%dx%d cells).",cellW,cellH);
+  waveThumbTex=rend->createTexture(true,cols*cellW,rows*cellH);
+  if (waveThumbTex==NULL) {
+    logE("error while creating wave thumbnail texture! %s",SDL_GetError());
+    return;
+  }
+  waveThumbData=new unsigned int[cols*cellW*rows*cellH];
+  memset(waveThumbData,0,cols*cellW*rows*cellH*sizeof(unsigned int));
+  memset(waveThumbKey,0,sizeof(uint64_t)*256);
+}
+
+void FurnaceGUI::drawWaveThumb(int index, const ImVec2& size) {
+  ImVec2 pad=ImGui::GetStyle().FramePadding;
+  int cellW=(int)(size.x-2.0f*pad.x);
+  int cellH=(int)(size.y-2.0f*pad.y);
+  waveThumbWantW=cellW;
+  waveThumbWantH=cellH;
+
+  DivWavetable* wave=e->song.wave[index];
+  bool useAtlas=false;
+  if (waveThumbTex!=NULL && cellW==waveThumbW && cellH==waveThumbH && index<waveThumbCols*waveThumbRows && wave->len>0 && wave->max>0) {
+    uint64_t key=waveThumbHash(wave);
+    if (key!=waveThumbKey[index]) waveThumbPending.push_back(index);
+    // a stale cell is still drawn until it is rasterized again
+    useAtlas=(waveThumbKey[index]!=0);
+  }
+
+  if (!useAtlas) {
+    // no cell of this size (yet)
+    float wavePreview[257];
+    for (int i=0; i<wave->len; i++) {
+      wavePreview[i]=wave->data[i];
+    }
+    if (wave->len>0) wavePreview[wave->len]=wave->data[wave->len-1];
+    PlotNoLerp(fmt::sprintf("##_WAVEP%d",index).c_str(),wavePreview,wave->len+1,0,NULL,0,wave->max,size);
+    return;
+  }
+
+  ImGui::Dummy(size);
+  if (!ImGui::IsItemVisible()) return;
+
+  ImDrawList* dl=ImGui::GetWindowDrawList();
+  ImVec2 minArea=ImGui::GetItemRectMin();
+  ImVec2 maxArea=ImGui::GetItemRectMax();
+  dl->AddRectFilled(minArea,maxArea,ImGui::GetColorU32(ImGuiCol_FrameBg),ImGui::GetStyle().FrameRounding);
+
+  float texW=waveThumbCols*waveThumbW;
+  float texH=waveThumbRows*waveThumbH;
+  ImVec2 uv0(
+    (float)((index%waveThumbCols)*waveThumbW)/texW,
+    (float)((index/waveThumbCols)*waveThumbH)/texH
+  );
+  ImVec2 uv1(
+    uv0.x+(float)waveThumbW/texW,
+    uv0.y+(float)waveThumbH/texH
+  );
+  // align to pixels to avoid filtering
+  ImVec2 pos(floorf(minArea.x+pad.x),floorf(minArea.y+pad.y));
+  dl->AddImage(rend->getTextureID(waveThumbTex),pos,ImVec2(pos.x+waveThumbW,pos.y+waveThumbH),uv0,uv1,ImGui::GetColorU32(ImGuiCol_PlotLines));
+}
+
+void FurnaceGUI::flushWaveThumbs() {
+  if (waveThumbTex==NULL || waveThumbData==NULL) return;
+  if (waveThumbPending.empty()) return;
+
+  int stride=waveThumbCols*waveThumbW;
+  int updated=0;
+  for (int index: waveThumbPending) {
+    if (updated>=WAVE_THUMB_MAX_UPDATES) break;
+    if (index<0 || index>=(int)e->song.wave.size() || index>=waveThumbCols*waveThumbRows) continue;
+    DivWavetable* wave=e->song.wave[index];
+    uint64_t key=waveThumbHash(wave);
+    // may have been listed twice
+    if (key==waveThumbKey[index]) continue;
+
+    unsigned int* cell=waveThumbData+(index/waveThumbCols)*waveThumbH*stride+(index%waveThumbCols)*waveThumbW;
+    for (int y=0; y<waveThumbH; y++) {
+      memset(cell+y*stride,0,waveThumbW*sizeof(unsigned int));
+    }
+
+    // step plot, one column at a time.
+    // columns covering more than one step draw their min/max range.
+    int prevY=-1;
+    for (int x=0; x<waveThumbW; x++) {
+      int start=(x*wave->len)/waveThumbW;
+      int end=((x+1)*wave->len)/waveThumbW;
+      if (end<=start) end=start+1;
+      if (end>wave->len) end=wave->len;
+      int minVal=wave->data[start];
+      int maxVal=minVal;
+      for (int i=start+1; i<end; i++) {
+        if (wave->data[i]<minVal) minVal=wave->data[i];
+        if (wave->data[i]>maxVal) maxVal=wave->data[i];
+      }
+      int y0=(waveThumbH-1)-(maxVal*(waveThumbH-1))/wave->max;
+      int y1=(waveThumbH-1)-(minVal*(waveThumbH-1))/wave->max;
+      // connect to the previous column
+      if (prevY>=0) {
+        if (prevY<y0) y0=prevY;
+        if (prevY>y1) y1=prevY;
+      }
+      if (y0<0) y0=0;
+      if (y1>waveThumbH-1) y1=waveThumbH-1;
+      for (int y=y0; y<=y1; y++) {
+        cell[y*stride+x]=0xffffffff;
+      }
+      prevY=(waveThumbH-1)-(wave->data[end-1]*(waveThumbH-1))/wave->max;
+    }
+
+    waveThumbKey[index]=key;
+    updated++;
   }
-  if (wave->len>0) wavePreview[wave->len]=wave->data[wave->len-1];
+  waveThumbPending.clear();
+
+  if (updated>0) {
+    texUpdates++;
+    if (!rend->updateTexture(waveThumbTex,waveThumbData,stride*4)) {
+      logE("error while updating wave thumbnail texture!");
+    }
+  }
+}
+
+void FurnaceGUI::waveListItem(int i, int dir, int asset) {
   ImVec2 curPos=ImGui::GetCursorPos();
   ImGui::PushStyleVar(ImGuiStyleVar_SelectableTextAlign,ImVec2(0,0.5f));
   if (ImGui::Selectable(fmt::sprintf(" %d##_WAVE%d\n",i,i).c_str(),curWave==i,0,ImVec2(0,ImGui::GetFrameHeight()))) {
@@ -196,7 +360,7 @@ void FurnaceGUI::waveListItem(int i, float* wavePreview, int dir, int asset) {
   }
   ImGui::SameLine();
   ImGui::SetCursorPos(curPos);
-  PlotNoLerp(fmt::sprintf("##_WAVEP%d",i).c_str(),wavePreview,wave->len+1,0,NULL,0,wave->max,ImVec2(ImGui::GetContentRegionAvail().x,ImGui::GetFrameHeight()));
+  drawWaveThumb(i,ImVec2(ImGui::GetContentRegionAvail().x,ImGui::GetFrameHeight()));
 }
 
 void FurnaceGUI::sampleListItem(int i, int dir, int asset) {
@@ -974,7 +1138,7 @@ void FurnaceGUI::drawSampleList(bool asChild) {
 }
 
 void FurnaceGUI::actualWaveList() {
-  float wavePreview[257];
+  prepareWaveThumbs();
 
   if (waveListDir || (settings.unifiedDataView && insListDir)) {
     ImGui::TableNextRow();
@@ -999,7 +1163,7 @@ void FurnaceGUI::actualWaveList() {
       if (treeNode) {
         int assetIndex=0;
         for (int j: i.entries) {
-          waveListItem(j,wavePreview,dirIndex,assetIndex);
+          waveListItem(j,dirIndex,assetIndex);
           assetIndex++;
         }
         ImGui::TreePop();
@@ -1016,9 +1180,11 @@ void FurnaceGUI::actualWaveList() {
     for (int i=0; i<(int)e->song.wave.size(); i++) {
       ImGui::TableNextRow();
       ImGui::TableNextColumn();
-      waveListItem(i,wavePreview,-1,-1);
+      waveListItem(i,-1,-1);
     }
   }
+
+  flushWaveThumbs();
 }
 
 void FurnaceGUI::actualSampleList() {
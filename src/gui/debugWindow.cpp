@@ -22,6 +22,7 @@
 #include "debug.h"
 #include "IconsFontAwesome4.h"
 #include <SDL_timer.h>
+#include <algorithm>
 #include <fmt/printf.h>
 #include <imgui.h>
 
@@ -108,9 +109,21 @@ void FurnaceGUI::drawDebug() {
     }
     if (ImGui::TreeNode("Channel Status")) {
       ImGui::Text("for best results set latency to minimum or use the Frame Advance button.");
+      const DivDebugSnapshot* snap=e->getDebugSnapshot();
+      DivChannelSummary direct;
       ImGui::Columns(e->getTotalChannelCount());
       for (int i=0; i<e->getTotalChannelCount(); i++) {
-        DivChannelState* ch=e->getChanState(i);
+        // use the snapshot taken by the audio thread if there is one
+        const DivChannelSummary* ch=NULL;
+        if (snap!=NULL) {
+          if (i<snap->chans) ch=&snap->chan[i];
+        } else {
+          DivChannelState* chanState=e->getChanState(i);
+          if (chanState!=NULL) {
+            direct.set(*chanState);
+            ch=&direct;
+          }
+        }
         ImGui::TextColored(uiColors[GUI_COLOR_ACCENT_PRIMARY],"Channel %d:",i);
         if (ch==NULL) {
           ImGui::Text("NULL");
@@ -617,12 +630,48 @@ void FurnaceGUI::drawDebug() {
       ImGui::Text("draw: %.0fµs",(double)drawTimeDelta/perfFreq);
       ImGui::Text("layout: %.0fµs",(double)layoutTimeDelta/perfFreq);
       ImGui::Text("event: %.0fµs",(double)eventTimeDelta/perfFreq);
+      ImGui::Text("skipped frames: %d",skippedFrames);
       ImGui::Separator();
 
       ImGui::Text("details:");
       for (int i=0; i<perfMetricsLastLen; i++) {
         ImGui::Text("%s: %.0fµs",perfMetricsLast[i].name,(double)perfMetricsLast[i].elapsed/perfFreq);
       }
+      ImGui::Separator();
+
+      ImGui::AlignTextToFramePadding();
+      ImGui::Text("per window:");
+      ImGui::SameLine();
+      if (ImGui::Button("Reset##PerfStats")) {
+        perfStats.clear();
+      }
+      std::vector<std::pair<String,FurnaceGUIPerfStat>> sortedStats(perfStats.begin(),perfStats.end());
+      std::sort(sortedStats.begin(),sortedStats.end(),[](const std::pair<String,FurnaceGUIPerfStat>& a, const std::pair<String,FurnaceGUIPerfStat>& b) {
+        return a.second.avg>b.second.avg;
+      });
+      if (ImGui::BeginTable("PerfStats",4,ImGuiTableFlags_Borders|ImGuiTableFlags_SizingStretchSame)) {
+        ImGui::TableNextRow(ImGuiTableRowFlags_Headers);
+        ImGui::TableNextColumn();
+        ImGui::Text("name");
+        ImGui::TableNextColumn();
+        ImGui::Text("last");
+        ImGui::TableNextColumn();
+        ImGui::Text("average");
+        ImGui::TableNextColumn();
+        ImGui::Text("peak");
+        for (std::pair<String,FurnaceGUIPerfStat>& i: sortedStats) {
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          ImGui::Text("%s",i.first.c_str());
+          ImGui::TableNextColumn();
+          ImGui::Text("%.0fµs",(double)i.second.cur/perfFreq);
+          ImGui::TableNextColumn();
+          ImGui::Text("%.0fµs",i.second.avg/perfFreq);
+          ImGui::TableNextColumn();
+          ImGui::Text("%.0fµs",(double)i.second.peak/perfFreq);
+        }
+        ImGui::EndTable();
+      }
       ImGui::TreePop();
     }
     if (ImGui::TreeNode("Settings")) {
@@ -52,6 +52,98 @@ const char* FurnaceGUI::noteNameNormal(short note, short octave) {
   return noteNames[seek];
 }
 
+// unchanged cells between two changes in a row are stored rather than
+// starting a new run if there are at most this many of them.
+#define UNDO_RUN_MAX_GAP 2
+
+void UndoStep::diffPatternRow(int subSong, int chan, int patIndex, int row, const short* oldRow, const short* newRow) {
+  const int rowStart=row*DIV_MAX_COLS;
+  for (int k=0; k<DIV_MAX_COLS; k++) {
+    if (oldRow[k]==newRow[k]) continue;
+
+    bool extend=false;
+    if (!pat.empty()) {
+      UndoPatternRun& last=pat.back();
+      if (last.subSong==subSong && last.chan==chan && last.pat==patIndex) {
+        int lastEnd=last.start+last.len;
+        if (lastEnd==rowStart+k) {
+          extend=true;
+        } else if (lastEnd>=rowStart && lastEnd<rowStart+k && (rowStart+k-lastEnd)<=UNDO_RUN_MAX_GAP) {
+          for (int g=lastEnd-rowStart; g<k; g++) {
+            patVals.push_back(oldRow[g]);
+            patVals.push_back(newRow[g]);
+            last.len++;
+          }
+          extend=true;
+        }
+      }
+    }
+    if (!extend) {
+      pat.push_back(UndoPatternRun(subSong,chan,patIndex,rowStart+k));
+    }
+    pat.back().len++;
+    patVals.push_back(oldRow[k]);
+    patVals.push_back(newRow[k]);
+  }
+}
+
+size_t UndoStep::memUsage() const {
+  return sizeof(UndoStep)+
+         ord.capacity()*sizeof(UndoOrderData)+
+         pat.capacity()*sizeof(UndoPatternRun)+
+         patVals.capacity()*sizeof(short)+
+         other.capacity()*sizeof(UndoOtherData);
+}
+
+void FurnaceGUI::pushUndo(const UndoStep& us) {
+  undoHist.push_back(us);
+  while (!redoHist.empty()) {
+    // release the memory held by the slot
+    redoHist.back()=UndoStep();
+    redoHist.pop_back();
+  }
+
+  // drop the oldest steps until both the step and memory limits are met
+  size_t memLimit=(size_t)settings.maxUndoMemory<<20;
+  size_t memTotal=0;
+  for (size_t i=0; i<undoHist.size(); i++) {
+    memTotal+=undoHist[i].memUsage();
+  }
+  while (undoHist.size()>1 && (undoHist.size()>settings.maxUndoSteps || memTotal>memLimit)) {
+    memTotal-=undoHist.front().memUsage();
+    undoHist.front()=UndoStep();
+    undoHist.pop_front();
+  }
+}
+
+void FurnaceGUI::clearUndoHistory() {
+  // FixedQueue::clear() doesn't destroy items, so release the memory held by each slot
+  while (!undoHist.empty()) {
+    undoHist.back()=UndoStep();
+    undoHist.pop_back();
+  }
+  while (!redoHist.empty()) {
+    redoHist.back()=UndoStep();
+    redoHist.pop_back();
+  }
+}
+
+void FurnaceGUI::applyUndoPattern(const UndoStep& us, bool redo) {
+  size_t valPos=redo?1:0;
+  int lastSubSong=-1;
+  for (const UndoPatternRun& i: us.pat) {
+    if (i.subSong!=lastSubSong) {
+      e->changeSongP(i.subSong);
+      lastSubSong=i.subSong;
+    }
+    DivPattern* p=e->curPat[i.chan].getPattern(i.pat,true);
+    for (int j=i.start; j<i.start+i.len; j++) {
+      p->data[j/DIV_MAX_COLS][j%DIV_MAX_COLS]=us.patVals[valPos];
+      valPos+=2;
+    }
+  }
+}
+
 void FurnaceGUI::prepareUndo(ActionType action, UndoRegion region) {
   if (region.begin.ord==-1) {
     region.begin.ord=curOrder;
@@ -96,20 +188,25 @@ void FurnaceGUI::prepareUndo(ActionType action, UndoRegion region) {
     case GUI_UNDO_PATTERN_COLLAPSE:
     case GUI_UNDO_PATTERN_EXPAND:
     case GUI_UNDO_PATTERN_DRAG:
+      // only the rows within the region are kept
       for (int h=region.begin.ord; h<=region.end.ord; h++) {
+        int jBegin=0;
+        int jEnd=e->curSubSong->patLen-1;
+
+        if (h==region.begin.ord) jBegin=region.begin.y;
+        if (h==region.end.ord) jEnd=region.end.y;
+        if (jEnd<jBegin) continue;
+
         for (int i=region.begin.x; i<=region.end.x; i++) {
           unsigned short id=h|(i<<8);
-          DivPattern* p=NULL;
+          const DivPattern* p=e->curPat[i].getPattern(e->curOrders->ord[i][h],false);
+          size_t off=oldPatData.size();
 
-          auto it=oldPatMap.find(id);
-          if (it==oldPatMap.end()) {
-            p=oldPatMap[id]=new DivPattern;
-            //logV("oldPatMap: allocating for %.4x",id);
-          } else {
-            p=it->second;
+          oldPatData.resize(off+(jEnd-jBegin+1)*DIV_MAX_COLS);
+          for (int j=jBegin; j<=jEnd; j++) {
+            memcpy(&oldPatData[off+(j-jBegin)*DIV_MAX_COLS],p->data[j],DIV_MAX_COLS*sizeof(short));
           }
-
-          e->curPat[i].getPattern(e->curOrders->ord[i][h],false)->copyOn(p);
+          oldPatMap[id]=UndoPatternSnapshot(jBegin,jEnd,off);
         }
       }
       break;
@@ -191,40 +288,43 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
     case GUI_UNDO_PATTERN_DRAG:
       for (int h=region.begin.ord; h<=region.end.ord; h++) {
         for (int i=region.begin.x; i<=region.end.x; i++) {
-          DivPattern* p=e->curPat[i].getPattern(e->curOrders->ord[i][h],false);
-          DivPattern* op=NULL;
+          const DivPattern* p=e->curPat[i].getPattern(e->curOrders->ord[i][h],false);
           unsigned short id=h|(i<<8);
 
           auto it=oldPatMap.find(id);
           if (it==oldPatMap.end()) {
             logW("no data in oldPatMap for channel %d!",i);
             continue;
-          } else {
-            op=it->second;
           }
+          const UndoPatternSnapshot& snap=it->second;
 
           int jBegin=0;
           int jEnd=e->curSubSong->patLen-1;
 
           if (h==region.begin.ord) jBegin=region.begin.y;
           if (h==region.end.ord) jEnd=region.end.y;
+          if (jBegin<snap.rowBegin) jBegin=snap.rowBegin;
+          if (jEnd>snap.rowEnd) jEnd=snap.rowEnd;
 
           for (int j=jBegin; j<=jEnd; j++) {
-            for (int k=0; k<DIV_MAX_COLS; k++) {
-              if (p->data[j][k]!=op->data[j][k]) {
-                s.pat.push_back(UndoPatternData(subSong,i,e->curOrders->ord[i][h],j,k,op->data[j][k],p->data[j][k]));
-
-                if (k>=4) {
-                  if (op->data[j][k&(~1)]==0x0b ||
-                      p->data[j][k&(~1)]==0x0b ||
-                      op->data[j][k&(~1)]==0x0d ||
-                      p->data[j][k&(~1)]==0x0d ||
-                      op->data[j][k&(~1)]==0xff ||
-                      p->data[j][k&(~1)]==0xff) {
-                    shallWalk=true;
-                  }
+            const short* oldRow=&oldPatData[snap.off+(j-snap.rowBegin)*DIV_MAX_COLS];
+            const short* newRow=p->data[j];
+            if (memcmp(oldRow,newRow,DIV_MAX_COLS*sizeof(short))==0) continue;
+
+            s.diffPatternRow(subSong,i,e->curOrders->ord[i][h],j,oldRow,newRow);
+
+            if (!shallWalk) {
+              for (int k=4; k<DIV_MAX_COLS; k++) {
+                if (oldRow[k]==newRow[k]) continue;
+                if (oldRow[k&(~1)]==0x0b ||
+                    newRow[k&(~1)]==0x0b ||
+                    oldRow[k&(~1)]==0x0d ||
+                    newRow[k&(~1)]==0x0d ||
+                    oldRow[k&(~1)]==0xff ||
+                    newRow[k&(~1)]==0xff) {
+                  shallWalk=true;
+                  break;
                 }
-
               }
             }
           }
@@ -242,19 +342,15 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
   }
   if (doPush) {
     MARK_MODIFIED;
-    undoHist.push_back(s);
-    redoHist.clear();
-    if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
+    pushUndo(s);
   }
   if (shallWalk) {
     e->walkSong(loopOrder,loopRow,loopEnd);
   }
 
   // garbage collection
-  for (std::pair<unsigned short,DivPattern*> i: oldPatMap) {
-    delete i.second;
-  }
   oldPatMap.clear();
+  oldPatData.clear();
 }
 
 void FurnaceGUI::doSelectAll() {
@@ -315,7 +411,8 @@ void FurnaceGUI::doSelectAll() {
 
 void FurnaceGUI::doDelete() {
   finishSelection();
-  prepareUndo(GUI_UNDO_PATTERN_DELETE);
+  UndoRegion ur(curOrder,selStart.xCoarse,selStart.y,curOrder,selEnd.xCoarse,selEnd.y);
+  prepareUndo(GUI_UNDO_PATTERN_DELETE,ur);
   curNibble=false;
 
   int iCoarse=selStart.xCoarse;
@@ -340,12 +437,11 @@ void FurnaceGUI::doDelete() {
     iFine=0;
   }
 
-  makeUndo(GUI_UNDO_PATTERN_DELETE);
+  makeUndo(GUI_UNDO_PATTERN_DELETE,ur);
 }
 
 void FurnaceGUI::doPullDelete() {
   finishSelection();
-  prepareUndo(GUI_UNDO_PATTERN_PULL);
   curNibble=false;
 
   if (settings.pullDeleteBehavior) {
@@ -363,6 +459,10 @@ void FurnaceGUI::doPullDelete() {
     sEnd.xFine=2+e->curPat[sEnd.xCoarse].effectCols*2;
   }
 
+  // rows below the selection move up
+  UndoRegion ur(curOrder,sStart.xCoarse,sStart.y,curOrder,sEnd.xCoarse,e->curSubSong->patLen-1);
+  prepareUndo(GUI_UNDO_PATTERN_PULL,ur);
+
   int iCoarse=sStart.xCoarse;
   int iFine=sStart.xFine;
   for (; iCoarse<=sEnd.xCoarse; iCoarse++) {
@@ -387,12 +487,11 @@ void FurnaceGUI::doPullDelete() {
     iFine=0;
   }
 
-  makeUndo(GUI_UNDO_PATTERN_PULL);
+  makeUndo(GUI_UNDO_PATTERN_PULL,ur);
 }
 
 void FurnaceGUI::doInsert() {
   finishSelection();
-  prepareUndo(GUI_UNDO_PATTERN_PUSH);
   curNibble=false;
 
   SelectionPoint sStart=selStart;
@@ -403,6 +502,10 @@ void FurnaceGUI::doInsert() {
     sEnd.xFine=2+e->curPat[sEnd.xCoarse].effectCols*2;
   }
 
+  // rows below the selection move down
+  UndoRegion ur(curOrder,sStart.xCoarse,sStart.y,curOrder,sEnd.xCoarse,e->curSubSong->patLen-1);
+  prepareUndo(GUI_UNDO_PATTERN_PUSH,ur);
+
   int iCoarse=sStart.xCoarse;
   int iFine=sStart.xFine;
   for (; iCoarse<=sEnd.xCoarse; iCoarse++) {
@@ -427,12 +530,13 @@ void FurnaceGUI::doInsert() {
     iFine=0;
   }
 
-  makeUndo(GUI_UNDO_PATTERN_PUSH);
+  makeUndo(GUI_UNDO_PATTERN_PUSH,ur);
 }
 
 void FurnaceGUI::doTranspose(int amount, OperationMask& mask) {
   finishSelection();
-  prepareUndo(GUI_UNDO_PATTERN_DELETE);
+  UndoRegion ur(curOrder,selStart.xCoarse,selStart.y,curOrder,selEnd.xCoarse,selEnd.y);
+  prepareUndo(GUI_UNDO_PATTERN_DELETE,ur);
   curNibble=false;
 
   int iCoarse=selStart.xCoarse;
@@ -487,7 +591,7 @@ void FurnaceGUI::doTranspose(int amount, OperationMask& mask) {
     iFine=0;
   }
 
-  makeUndo(GUI_UNDO_PATTERN_DELETE);
+  makeUndo(GUI_UNDO_PATTERN_DELETE,ur);
 }
 
 String FurnaceGUI::doCopy(bool cut, bool writeClipboard, const SelectionPoint& sStart, const SelectionPoint& sEnd) {
@@ -1712,11 +1816,7 @@ void FurnaceGUI::doCollapseSong(int divider) {
 
       // put undo
       for (int k=0; k<DIV_MAX_ROWS; k++) {
-        for (int l=0; l<DIV_MAX_COLS; l++) {
-          if (pat->data[k][l]!=patCopy.data[k][l]) {
-            us.pat.push_back(UndoPatternData(subSong,i,j,k,l,patCopy.data[k][l],pat->data[k][l]));
-          }
-        }
+        us.diffPatternRow(subSong,i,j,k,patCopy.data[k],pat->data[k]);
       }
     }
   }
@@ -1735,9 +1835,7 @@ void FurnaceGUI::doCollapseSong(int divider) {
   }
 
   if (!us.pat.empty()) {
-    undoHist.push_back(us);
-    redoHist.clear();
-    if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
+    pushUndo(us);
   }
   
   if (e->isPlaying()) e->play();
@@ -1792,11 +1890,7 @@ void FurnaceGUI::doExpandSong(int multiplier) {
 
       // put undo
       for (int k=0; k<DIV_MAX_ROWS; k++) {
-        for (int l=0; l<DIV_MAX_COLS; l++) {
-          if (pat->data[k][l]!=patCopy.data[k][l]) {
-            us.pat.push_back(UndoPatternData(subSong,i,j,k,l,patCopy.data[k][l],pat->data[k][l]));
-          }
-        }
+        us.diffPatternRow(subSong,i,j,k,patCopy.data[k],pat->data[k]);
       }
     }
   }
@@ -1815,9 +1909,7 @@ void FurnaceGUI::doExpandSong(int multiplier) {
   }
 
   if (!us.pat.empty()) {
-    undoHist.push_back(us);
-    redoHist.clear();
-    if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
+    pushUndo(us);
   }
 
   if (e->isPlaying()) e->play();
@@ -1875,11 +1967,7 @@ void FurnaceGUI::doUndo() {
     case GUI_UNDO_PATTERN_EXPAND_SONG:
     case GUI_UNDO_PATTERN_DRAG:
     case GUI_UNDO_REPLACE:
-      for (UndoPatternData& i: us.pat) {
-        e->changeSongP(i.subSong);
-        DivPattern* p=e->curPat[i.chan].getPattern(i.pat,true);
-        p->data[i.row][i.col]=i.oldVal;
-      }
+      applyUndoPattern(us,false);
       if (us.type!=GUI_UNDO_REPLACE) {
         if (!e->isPlaying() || !followPattern) {
           cursor=us.cursor;
@@ -1915,6 +2003,7 @@ void FurnaceGUI::doUndo() {
     e->setOrder(curOrder);
   }
 
+  undoHist.back()=UndoStep();
   undoHist.pop_back();
 }
 
@@ -1951,11 +2040,7 @@ void FurnaceGUI::doRedo() {
     case GUI_UNDO_PATTERN_COLLAPSE_SONG:
     case GUI_UNDO_PATTERN_EXPAND_SONG:
     case GUI_UNDO_REPLACE:
-      for (UndoPatternData& i: us.pat) {
-        e->changeSongP(i.subSong);
-        DivPattern* p=e->curPat[i.chan].getPattern(i.pat,true);
-        p->data[i.row][i.col]=i.newVal;
-      }
+      applyUndoPattern(us,true);
       if (us.type!=GUI_UNDO_REPLACE) {
         if (!e->isPlaying() || !followPattern) {
           cursor=us.cursor;
@@ -1991,5 +2076,6 @@ void FurnaceGUI::doRedo() {
     e->setOrder(curOrder);
   }
 
+  redoHist.back()=UndoStep();
   redoHist.pop_back();
 }
@@ -90,25 +90,179 @@ bool checkCondition(int mode, int arg, int argMax, int val, bool noteMode=false)
   return false;
 }
 
-void FurnaceGUI::doFind() {
-  int firstOrder=0;
-  int lastOrder=e->curSubSong->ordersLen-1;
+// matches a single row against every query.
+// effectPos receives the columns of the matched effects.
+static bool matchQuery(const std::vector<FurnaceGUIFindQuery>& query, int effectPosMode, int effectCols, const short* row, signed char* effectPos) {
+  for (const FurnaceGUIFindQuery& l: query) {
+    memset(effectPos,-1,8);
+
+    if (!checkCondition(l.noteMode,l.note,l.noteMax,queryNote(row[0],row[1]),true)) continue;
+    if (!checkCondition(l.insMode,l.ins,l.insMax,row[2])) continue;
+    if (!checkCondition(l.volMode,l.vol,l.volMax,row[3])) continue;
+
+    if (l.effectCount>0) {
+      bool notMatched=false;
+      switch (effectPosMode) {
+        case 0: // no
+          for (int m=0; m<l.effectCount; m++) {
+            bool allGood=false;
+            for (int n=0; n<effectCols; n++) {
+              if (!checkCondition(l.effectMode[m],l.effect[m],l.effectMax[m],row[4+n*2])) continue;
+              if (!checkCondition(l.effectValMode[m],l.effectVal[m],l.effectValMax[m],row[5+n*2])) continue;
+              allGood=true;
+              effectPos[m]=n;
+              break;
+            }
+            if (!allGood) {
+              notMatched=true;
+              break;
+            }
+          }
+          break;
+        case 1: { // lax
+          // locate first effect
+          int posOfFirst=-1;
+          for (int m=0; m<effectCols; m++) {
+            if (!checkCondition(l.effectMode[0],l.effect[0],l.effectMax[0],row[4+m*2])) continue;
+            if (!checkCondition(l.effectValMode[0],l.effectVal[0],l.effectValMax[0],row[5+m*2])) continue;
+            posOfFirst=m;
+            break;
+          }
+          if (posOfFirst<0) {
+            notMatched=true;
+            break;
+          }
+          // make sure we aren't too far to the right
+          if ((posOfFirst+l.effectCount)>effectCols) {
+            notMatched=true;
+            break;
+          }
+          // search from first effect location
+          for (int m=0; m<l.effectCount; m++) {
+            if (!checkCondition(l.effectMode[m],l.effect[m],l.effectMax[m],row[4+(m+posOfFirst)*2])) {
+              notMatched=true;
+              break;
+            }
+            if (!checkCondition(l.effectValMode[m],l.effectVal[m],l.effectValMax[m],row[5+(m+posOfFirst)*2])) {
+              notMatched=true;
+              break;
+            }
+            effectPos[m]=m+posOfFirst;
+          }
+          break;
+        }
+        case 2: // strict
+          int effectMax=l.effectCount;
+          if (effectMax>effectCols) {
+            notMatched=true;
+          } else {
+            for (int m=0; m<effectMax; m++) {
+              if (!checkCondition(l.effectMode[m],l.effect[m],l.effectMax[m],row[4+m*2])) {
+                notMatched=true;
+                break;
+              }
+              if (!checkCondition(l.effectValMode[m],l.effectVal[m],l.effectValMax[m],row[5+m*2])) {
+                notMatched=true;
+                break;
+              }
+              effectPos[m]=m;
+            }
+          }
+          break;
+      }
+      if (notMatched) continue;
+    }
+
+    return true;
+  }
+  return false;
+}
 
-  if (curQueryRangeY==1 || curQueryRangeY==2) {
-    firstOrder=curOrder;
-    lastOrder=curOrder;
+// matching rows of a pattern, as found by findInSubSong.
+struct FindPatternHits {
+  unsigned long long rows[DIV_MAX_ROWS/64];
+  unsigned char slot[DIV_MAX_ROWS];
+  std::vector<signed char> effectPos;
+
+  FindPatternHits() {
+    memset(rows,0,sizeof(rows));
+    memset(slot,0,sizeof(slot));
   }
+};
 
-  int firstRow=0;
-  int lastRow=e->curSubSong->patLen-1;
+struct FindJob {
+  const std::vector<FurnaceGUIFindQuery>* query;
+  DivSubSong* sub;
+  int subIndex, effectPosMode;
+  int firstOrder, lastOrder, firstRow, lastRow, firstChan, lastChan;
+  std::vector<FurnaceGUIQueryResult> results;
+};
 
-  if (curQueryRangeY==1) {
-    finishSelection();
+// searches one subsong.
+// each pattern is only matched once no matter how many orders use it. the
+// results are then laid out by walking the orders over the resulting index,
+// skipping rows where no channel has a hit.
+static void findInSubSong(void* d) {
+  FindJob* job=(FindJob*)d;
+  DivSubSong* sub=job->sub;
+  const int chans=job->lastChan-job->firstChan+1;
+
+  // -1: not matched yet, -2: no hits, otherwise an index into hits
+  std::vector<int> patSlot(chans*DIV_MAX_PATTERNS,-1);
+  std::vector<FindPatternHits> hits;
+  signed char effectPos[8];
 
-    firstRow=selStart.y;
-    lastRow=selEnd.y;
+  for (int i=job->firstOrder; i<=job->lastOrder; i++) {
+    for (int k=0; k<chans; k++) {
+      const int chan=job->firstChan+k;
+      const int patIndex=sub->orders.ord[chan][i];
+      int& slot=patSlot[k*DIV_MAX_PATTERNS+patIndex];
+      if (slot!=-1) continue;
+      slot=-2;
+
+      const DivPattern* p=sub->pat[chan].getPattern(patIndex,false);
+      const int effectCols=sub->pat[chan].effectCols;
+      for (int j=job->firstRow; j<=job->lastRow; j++) {
+        if (!matchQuery(*job->query,job->effectPosMode,effectCols,p->data[j],effectPos)) continue;
+        if (slot<0) {
+          slot=hits.size();
+          hits.push_back(FindPatternHits());
+        }
+        FindPatternHits& h=hits[slot];
+        h.rows[j>>6]|=1ULL<<(j&63);
+        h.slot[j]=h.effectPos.size()/8;
+        h.effectPos.insert(h.effectPos.end(),effectPos,effectPos+8);
+      }
+    }
   }
 
+  if (hits.empty()) return;
+
+  for (int i=job->firstOrder; i<=job->lastOrder; i++) {
+    unsigned long long anyRows[DIV_MAX_ROWS/64];
+    memset(anyRows,0,sizeof(anyRows));
+    for (int k=0; k<chans; k++) {
+      int slot=patSlot[k*DIV_MAX_PATTERNS+sub->orders.ord[job->firstChan+k][i]];
+      if (slot<0) continue;
+      for (int w=0; w<DIV_MAX_ROWS/64; w++) {
+        anyRows[w]|=hits[slot].rows[w];
+      }
+    }
+
+    for (int j=job->firstRow; j<=job->lastRow; j++) {
+      if (!(anyRows[j>>6]&(1ULL<<(j&63)))) continue;
+      for (int k=0; k<chans; k++) {
+        int slot=patSlot[k*DIV_MAX_PATTERNS+sub->orders.ord[job->firstChan+k][i]];
+        if (slot<0) continue;
+        FindPatternHits& h=hits[slot];
+        if (!(h.rows[j>>6]&(1ULL<<(j&63)))) continue;
+        job->results.push_back(FurnaceGUIQueryResult(job->subIndex,i,job->firstChan+k,j,&h.effectPos[h.slot[j]*8]));
+      }
+    }
+  }
+}
+
+void FurnaceGUI::doFind() {
   int firstChan=0;
   int lastChan=e->getTotalChannelCount()-1;
 
@@ -118,112 +272,77 @@ void FurnaceGUI::doFind() {
   }
 
   curQueryResults.clear();
+  queryViewingResults=true;
 
-  signed char effectPos[8];
+  if (firstChan>lastChan) return;
 
-  for (int i=firstOrder; i<=lastOrder; i++) {
-    for (int j=firstRow; j<=lastRow; j++) {
-      for (int k=firstChan; k<=lastChan; k++) {
-        DivPattern* p=e->curPat[k].getPattern(e->curOrders->ord[k][i],false);
-        bool matched=false;
-        memset(effectPos,-1,8);
-        for (FurnaceGUIFindQuery& l: curQuery) {
-          if (matched) break;
-
-          if (!checkCondition(l.noteMode,l.note,l.noteMax,queryNote(p->data[j][0],p->data[j][1]),true)) continue;
-          if (!checkCondition(l.insMode,l.ins,l.insMax,p->data[j][2])) continue;
-          if (!checkCondition(l.volMode,l.vol,l.volMax,p->data[j][3])) continue;
-
-          if (l.effectCount>0) {
-            bool notMatched=false;
-            switch (curQueryEffectPos) {
-              case 0: // no
-                for (int m=0; m<l.effectCount; m++) {
-                  bool allGood=false;
-                  for (int n=0; n<e->curPat[k].effectCols; n++) {
-                    if (!checkCondition(l.effectMode[m],l.effect[m],l.effectMax[m],p->data[j][4+n*2])) continue;
-                    if (!checkCondition(l.effectValMode[m],l.effectVal[m],l.effectValMax[m],p->data[j][5+n*2])) continue;
-                    allGood=true;
-                    effectPos[m]=n;
-                    break;
-                  }
-                  if (!allGood) {
-                    notMatched=true;
-                    break;
-                  }
-                }
-                break;
-              case 1: { // lax
-                // locate first effect
-                int posOfFirst=-1;
-                for (int m=0; m<e->curPat[k].effectCols; m++) {
-                  if (!checkCondition(l.effectMode[0],l.effect[0],l.effectMax[0],p->data[j][4+m*2])) continue;
-                  if (!checkCondition(l.effectValMode[0],l.effectVal[0],l.effectValMax[0],p->data[j][5+m*2])) continue;
-                  posOfFirst=m;
-                  break;
-                }
-                if (posOfFirst<0) {
-                  notMatched=true;
-                  break;
-                }
-                // make sure we aren't too far to the right
-                if ((posOfFirst+l.effectCount)>e->curPat[k].effectCols) {
-                  notMatched=true;
-                  break;
-                }
-                // search from first effect location
-                for (int m=0; m<l.effectCount; m++) {
-                  if (!checkCondition(l.effectMode[m],l.effect[m],l.effectMax[m],p->data[j][4+(m+posOfFirst)*2])) {
-                    notMatched=true;
-                    break;
-                  }
-                  if (!checkCondition(l.effectValMode[m],l.effectVal[m],l.effectValMax[m],p->data[j][5+(m+posOfFirst)*2])) {
-                    notMatched=true;
-                    break;
-                  }
-                  effectPos[m]=m+posOfFirst;
-                }
-                break;
-              }
-              case 2: // strict
-                int effectMax=l.effectCount;
-                if (effectMax>e->curPat[k].effectCols) {
-                  notMatched=true;
-                } else {
-                  for (int m=0; m<effectMax; m++) {
-                    if (!checkCondition(l.effectMode[m],l.effect[m],l.effectMax[m],p->data[j][4+m*2])) {
-                      notMatched=true;
-                      break;
-                    }
-                    if (!checkCondition(l.effectValMode[m],l.effectVal[m],l.effectValMax[m],p->data[j][5+m*2])) {
-                      notMatched=true;
-                      break;
-                    }
-                    effectPos[m]=m;
-                  }
-                }
-                break;
-            }
-            if (notMatched) continue;
-          }
+  std::vector<FindJob> jobs;
 
-          matched=true;
-        }
-        if (matched) {
-          curQueryResults.push_back(FurnaceGUIQueryResult(e->getCurrentSubSong(),i,k,j,effectPos));
-        }
-      }
+  if (curQueryRangeY==3) {
+    jobs.resize(e->song.subsong.size());
+    for (size_t i=0; i<e->song.subsong.size(); i++) {
+      FindJob& job=jobs[i];
+      job.sub=e->song.subsong[i];
+      job.subIndex=i;
+      job.firstOrder=0;
+      job.lastOrder=job.sub->ordersLen-1;
+      job.firstRow=0;
+      job.lastRow=job.sub->patLen-1;
+    }
+  } else {
+    jobs.resize(1);
+    FindJob& job=jobs[0];
+    job.sub=e->curSubSong;
+    job.subIndex=e->getCurrentSubSong();
+    job.firstOrder=0;
+    job.lastOrder=job.sub->ordersLen-1;
+    job.firstRow=0;
+    job.lastRow=job.sub->patLen-1;
+
+    if (curQueryRangeY==1 || curQueryRangeY==2) {
+      job.firstOrder=curOrder;
+      job.lastOrder=curOrder;
+    }
+
+    if (curQueryRangeY==1) {
+      finishSelection();
+
+      job.firstRow=selStart.y;
+      job.lastRow=selEnd.y;
     }
   }
-  queryViewingResults=true;
+
+  for (FindJob& job: jobs) {
+    job.query=&curQuery;
+    job.effectPosMode=curQueryEffectPos;
+    job.firstChan=firstChan;
+    job.lastChan=lastChan;
+  }
+
+  if (jobs.size()>1 && cpuCores>1) {
+    DivWorkPool* pool=new DivWorkPool(MIN((size_t)cpuCores,jobs.size()));
+    for (FindJob& job: jobs) {
+      pool->push(findInSubSong,&job);
+    }
+    pool->wait();
+    delete pool;
+  } else {
+    for (FindJob& job: jobs) {
+      findInSubSong(&job);
+    }
+  }
+
+  for (FindJob& job: jobs) {
+    curQueryResults.insert(curQueryResults.end(),job.results.begin(),job.results.end());
+  }
 }
 
 void FurnaceGUI::doReplace() {
   doFind();
   queryViewingResults=false;
 
-  bool* touched[DIV_MAX_CHANS];
-  memset(touched,0,DIV_MAX_CHANS*sizeof(bool*));
+  // one bit per pattern row for each subsong/channel, allocated on first hit
+  std::vector<std::vector<unsigned long long>> touched(e->song.subsong.size()*DIV_MAX_CHANS);
 
   UndoStep us;
   us.type=GUI_UNDO_REPLACE;
@@ -234,12 +353,13 @@ void FurnaceGUI::doReplace() {
   for (FurnaceGUIQueryResult& i: curQueryResults) {
     int patIndex=e->song.subsong[i.subsong]->orders.ord[i.x][i.order];
     DivPattern* p=e->song.subsong[i.subsong]->pat[i.x].getPattern(patIndex,true);
-    if (touched[i.x]==NULL) {
-      touched[i.x]=new bool[DIV_MAX_PATTERNS*DIV_MAX_ROWS];
-      memset(touched[i.x],0,DIV_MAX_PATTERNS*DIV_MAX_ROWS*sizeof(bool));
+    std::vector<unsigned long long>& touchedRows=touched[i.subsong*DIV_MAX_CHANS+i.x];
+    if (touchedRows.empty()) {
+      touchedRows.resize((DIV_MAX_PATTERNS*DIV_MAX_ROWS)/64,0);
     }
-    if (touched[i.x][(patIndex<<8)|i.y]) continue;
-    touched[i.x][(patIndex<<8)|i.y]=true;
+    const int touchedPos=patIndex*DIV_MAX_ROWS+i.y;
+    if (touchedRows[touchedPos>>6]&(1ULL<<(touchedPos&63))) continue;
+    touchedRows[touchedPos>>6]|=1ULL<<(touchedPos&63);
 
     memcpy(prevVal,p->data[i.y],DIV_MAX_COLS*sizeof(short));
 
@@ -476,15 +596,7 @@ void FurnaceGUI::doReplace() {
     }
 
     // issue undo step
-    for (int j=0; j<DIV_MAX_COLS; j++) {
-      if (p->data[i.y][j]!=prevVal[j]) {
-        us.pat.push_back(UndoPatternData(i.subsong,i.x,patIndex,i.y,j,prevVal[j],p->data[i.y][j]));
-      }
-    }
-  }
-
-  for (int i=0; i<DIV_MAX_CHANS; i++) {
-    if (touched[i]!=NULL) delete[] touched[i];
+    us.diffPatternRow(i.subsong,i.x,patIndex,i.y,prevVal,p->data[i.y]);
   }
 
   if (!curQueryResults.empty()) {
@@ -492,9 +604,7 @@ void FurnaceGUI::doReplace() {
   }
 
   if (!us.pat.empty()) {
-    undoHist.push_back(us);
-    redoHist.clear();
-    if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
+    pushUndo(us);
   }
 }
 
@@ -522,7 +632,9 @@ void FurnaceGUI::drawFindReplace() {
           if (!curQueryResults.empty()) {
             ImVec2 avail=ImGui::GetContentRegionAvail();
             avail.y-=ImGui::GetFrameHeightWithSpacing();
-            if (ImGui::BeginTable("FindResults",4,ImGuiTableFlags_Borders|ImGuiTableFlags_ScrollY,avail)) {
+            bool showSubSong=(curQueryRangeY==3);
+            if (ImGui::BeginTable("FindResults",showSubSong?5:4,ImGuiTableFlags_Borders|ImGuiTableFlags_ScrollY,avail)) {
+              if (showSubSong) ImGui::TableSetupColumn("cs",ImGuiTableColumnFlags_WidthFixed,ImGui::CalcTextSize("subsong").x);
               ImGui::TableSetupColumn("c0",ImGuiTableColumnFlags_WidthFixed,ImGui::CalcTextSize("order").x);
               ImGui::TableSetupColumn("c1",ImGuiTableColumnFlags_WidthFixed,ImGui::CalcTextSize("row").x);
               ImGui::TableSetupColumn("c2",ImGuiTableColumnFlags_WidthStretch);
@@ -531,6 +643,10 @@ void FurnaceGUI::drawFindReplace() {
               ImGui::TableSetupScrollFreeze(0,1);
 
               ImGui::TableNextRow(ImGuiTableRowFlags_Headers);
+              if (showSubSong) {
+                ImGui::TableNextColumn();
+                ImGui::Text("subsong");
+              }
               ImGui::TableNextColumn();
               ImGui::Text("order");
               ImGui::TableNextColumn();
@@ -543,6 +659,10 @@ void FurnaceGUI::drawFindReplace() {
               int index=0;
               for (FurnaceGUIQueryResult& i: curQueryResults) {
                 ImGui::TableNextRow();
+                if (showSubSong) {
+                  ImGui::TableNextColumn();
+                  ImGui::Text("%d",i.subsong+1);
+                }
                 ImGui::TableNextColumn();
                 if (settings.orderRowsBase==1) {
                   ImGui::Text("%.2X",i.order);
@@ -794,6 +914,9 @@ void FurnaceGUI::drawFindReplace() {
             if (ImGui::RadioButton("Pattern",curQueryRangeY==2)) {
               curQueryRangeY=2;
             }
+            if (ImGui::RadioButton("All subsongs",curQueryRangeY==3)) {
+              curQueryRangeY=3;
+            }
 
             ImGui::TableNextColumn();
             ImGui::Checkbox("Confine to channels",&curQueryRangeX);
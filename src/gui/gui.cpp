@@ -1181,8 +1181,9 @@ void FurnaceGUI::stopPreviewNote(SDL_Scancode scancode, bool autoNote) {
 void FurnaceGUI::noteInput(int num, int key, int vol) {
   DivPattern* pat=e->curPat[cursor.xCoarse].getPattern(e->curOrders->ord[cursor.xCoarse][curOrder],true);
   bool removeIns=false;
+  UndoRegion ur(curOrder,cursor.xCoarse,cursor.y,curOrder,cursor.xCoarse,cursor.y);
 
-  prepareUndo(GUI_UNDO_PATTERN_EDIT);
+  prepareUndo(GUI_UNDO_PATTERN_EDIT,ur);
 
   if (key==GUI_NOTE_OFF) { // note off
     pat->data[cursor.y][0]=100;
@@ -1229,14 +1230,15 @@ void FurnaceGUI::noteInput(int num, int key, int vol) {
       pat->data[cursor.y][3]=-1;
     }
   }
-  makeUndo(GUI_UNDO_PATTERN_EDIT);
+  makeUndo(GUI_UNDO_PATTERN_EDIT,ur);
   editAdvance();
   curNibble=false;
 }
 
 void FurnaceGUI::valueInput(int num, bool direct, int target) {
   DivPattern* pat=e->curPat[cursor.xCoarse].getPattern(e->curOrders->ord[cursor.xCoarse][curOrder],true);
-  prepareUndo(GUI_UNDO_PATTERN_EDIT);
+  UndoRegion ur(curOrder,cursor.xCoarse,cursor.y,curOrder,cursor.xCoarse,cursor.y);
+  prepareUndo(GUI_UNDO_PATTERN_EDIT,ur);
   if (target==-1) target=cursor.xFine+1;
   if (direct) {
     pat->data[cursor.y][target]=num&0xff;
@@ -1260,7 +1262,7 @@ void FurnaceGUI::valueInput(int num, bool direct, int target) {
       wavePreviewInit=true;
       updateFMPreview=true;
     }
-    makeUndo(GUI_UNDO_PATTERN_EDIT);
+    makeUndo(GUI_UNDO_PATTERN_EDIT,ur);
     if (direct) {
       curNibble=false;
     } else {
@@ -1278,7 +1280,7 @@ void FurnaceGUI::valueInput(int num, bool direct, int target) {
     } else {
       pat->data[cursor.y][target]&=15;
     }
-    makeUndo(GUI_UNDO_PATTERN_EDIT);
+    makeUndo(GUI_UNDO_PATTERN_EDIT,ur);
     if (direct) {
       curNibble=false;
     } else {
@@ -1292,7 +1294,7 @@ void FurnaceGUI::valueInput(int num, bool direct, int target) {
       }
     }
   } else {
-    makeUndo(GUI_UNDO_PATTERN_EDIT);
+    makeUndo(GUI_UNDO_PATTERN_EDIT,ur);
     if (direct) {
       curNibble=false;
     } else {
@@ -2072,6 +2074,8 @@ int FurnaceGUI::save(String path, int dmfVersion) {
   if (dmfVersion) {
     if (dmfVersion<24) dmfVersion=24;
     w=e->saveDMF(dmfVersion);
+  } else if (settings.compress && settings.compressChunked) {
+    w=e->saveFurChunked(settings.newPatternFormat);
   } else {
     w=e->saveFur(false,settings.newPatternFormat);
   }
@@ -2088,65 +2092,27 @@ int FurnaceGUI::save(String path, int dmfVersion) {
     w->finish();
     return 1;
   }
-  if (settings.compress) {
-    unsigned char zbuf[131072];
-    int ret;
-    z_stream zl;
-    memset(&zl,0,sizeof(z_stream));
-    ret=deflateInit(&zl,Z_DEFAULT_COMPRESSION);
-    if (ret!=Z_OK) {
+  // chunked files are already compressed
+  if (settings.compress && !(settings.compressChunked && !dmfVersion)) {
+    SafeWriter* zw=e->compressFile(w->getFinalBuf(),w->size());
+    if (zw==NULL) {
       logE("zlib error!");
       lastError="compression error";
       fclose(outFile);
       w->finish();
       return 2;
     }
-    zl.avail_in=w->size();
-    zl.next_in=w->getFinalBuf();
-    while (zl.avail_in>0) {
-      zl.avail_out=131072;
-      zl.next_out=zbuf;
-      if ((ret=deflate(&zl,Z_NO_FLUSH))==Z_STREAM_ERROR) {
-        logE("zlib stream error!");
-        lastError="zlib stream error";
-        deflateEnd(&zl);
-        fclose(outFile);
-        w->finish();
-        return 2;
-      }
-      size_t amount=131072-zl.avail_out;
-      if (amount>0) {
-        if (fwrite(zbuf,1,amount,outFile)!=amount) {
-          logE("did not write entirely: %s!",strerror(errno));
-          lastError=strerror(errno);
-          deflateEnd(&zl);
-          fclose(outFile);
-          w->finish();
-          return 1;
-        }
-      }
-    }
-    zl.avail_out=131072;
-    zl.next_out=zbuf;
-    if ((ret=deflate(&zl,Z_FINISH))==Z_STREAM_ERROR) {
-      logE("zlib finish stream error!");
-      lastError="zlib finish stream error";
-      deflateEnd(&zl);
+    if (fwrite(zw->getFinalBuf(),1,zw->size(),outFile)!=zw->size()) {
+      logE("did not write entirely: %s!",strerror(errno));
+      lastError=strerror(errno);
       fclose(outFile);
+      zw->finish();
+      delete zw;
       w->finish();
-      return 2;
-    }
-    if (131072-zl.avail_out>0) {
-      if (fwrite(zbuf,1,131072-zl.avail_out,outFile)!=(131072-zl.avail_out)) {
-        logE("did not write entirely: %s!",strerror(errno));
-        lastError=strerror(errno);
-        deflateEnd(&zl);
-        fclose(outFile);
-        w->finish();
-        return 1;
-      }
+      return 1;
     }
-    deflateEnd(&zl);
+    zw->finish();
+    delete zw;
   } else {
     if (fwrite(w->getFinalBuf(),1,w->size(),outFile)!=w->size()) {
       logE("did not write entirely: %s!",strerror(errno));
@@ -2242,8 +2208,7 @@ int FurnaceGUI::load(String path) {
   selEnd=SelectionPoint();
   cursor=SelectionPoint();
   lastError="everything OK";
-  undoHist.clear();
-  redoHist.clear();
+  clearUndoHistory();
   updateWindowTitle();
   updateScroll(0);
   if (!e->getWarnings().empty()) {
@@ -2572,6 +2537,9 @@ void FurnaceGUI::processDrags(int dragX, int dragY) {
           if (val>127) val=127;
           for (int i=x; i<=x1; i++) ((signed char*)sampleDragTarget)[i]=val;
         }
+        if (curSample>=0 && curSample<(int)e->song.sample.size()) {
+          e->song.sample[curSample]->invalidatePeaks(x,x1+1);
+        }
         updateSampleTex=true;
       }
     } else { // select
@@ -3415,6 +3383,45 @@ bool FurnaceGUI::detectOutOfBoundsWindow(SDL_Rect& failing) {
   return false;
 }
 
+static inline uint64_t hashBytes(uint64_t h, const void* data, size_t len) {
+  const unsigned char* p=(const unsigned char*)data;
+  uint64_t w;
+  for (; len>=8; len-=8, p+=8) {
+    memcpy(&w,p,8);
+    h=(h^w)*0x100000001b3ULL;
+    h^=h>>29;
+  }
+  for (; len>0; len--, p++) {
+    h=(h^*p)*0x100000001b3ULL;
+  }
+  return h;
+}
+
+// hashes everything that affects the look of a frame, to tell whether it
+// can be skipped. returns 0 if the frame must always be drawn.
+static uint64_t hashDrawData(ImDrawData* dd, uint64_t seed) {
+  if (dd==NULL) return 0;
+  uint64_t h=0xcbf29ce484222325ULL^seed;
+  h=hashBytes(h,&dd->DisplayPos,sizeof(ImVec2));
+  h=hashBytes(h,&dd->DisplaySize,sizeof(ImVec2));
+  h=hashBytes(h,&dd->FramebufferScale,sizeof(ImVec2));
+  for (int i=0; i<dd->CmdListsCount; i++) {
+    const ImDrawList* dl=dd->CmdLists[i];
+    for (const ImDrawCmd& cmd: dl->CmdBuffer) {
+      // callbacks (e.g. the oscilloscope shader) draw things we can't see
+      if (cmd.UserCallback!=NULL) return 0;
+      h=hashBytes(h,&cmd.ClipRect,sizeof(ImVec4));
+      h=hashBytes(h,&cmd.TextureId,sizeof(ImTextureID));
+      h=hashBytes(h,&cmd.VtxOffset,sizeof(unsigned int));
+      h=hashBytes(h,&cmd.IdxOffset,sizeof(unsigned int));
+      h=hashBytes(h,&cmd.ElemCount,sizeof(unsigned int));
+    }
+    h=hashBytes(h,dl->VtxBuffer.Data,dl->VtxBuffer.Size*sizeof(ImDrawVert));
+    h=hashBytes(h,dl->IdxBuffer.Data,dl->IdxBuffer.Size*sizeof(ImDrawIdx));
+  }
+  return (h==0)?1:h;
+}
+
 #define DECLARE_METRIC(_n) \
   uint64_t __perfM##_n;
 
@@ -3497,6 +3504,18 @@ bool FurnaceGUI::loop() {
     SDL_Event ev;
     if (e->isPlaying()) {
       WAKE_UP;
+      // redraws caused by playback alone are paced at the visualization rate.
+      // any event wakes the loop up immediately.
+      if (settings.visualizerRate>0 && !frameHadEvents) {
+        uint64_t perfFreq=SDL_GetPerformanceFrequency();
+        uint64_t period=perfFreq/settings.visualizerRate;
+        uint64_t elapsed=SDL_GetPerformanceCounter()-lastVisFrame;
+        if (elapsed<period) {
+          int waitTime=(int)(((period-elapsed)*1000)/perfFreq);
+          if (waitTime>0) SDL_WaitEventTimeout(NULL,waitTime);
+        }
+      }
+      lastVisFrame=SDL_GetPerformanceCounter();
     }
     if (--drawHalt<=0) {
       drawHalt=0;
@@ -3507,7 +3526,22 @@ bool FurnaceGUI::loop() {
     perfMetricsLastLen=perfMetricsLen;
     perfMetricsLen=0;
 
+    if (debugOpen) {
+      // accumulate per-window times (some windows are measured more than once)
+      for (std::pair<const String,FurnaceGUIPerfStat>& i: perfStats) {
+        i.second.cur=0;
+      }
+      for (int i=0; i<perfMetricsLastLen; i++) {
+        perfStats[perfMetricsLast[i].name].cur+=perfMetricsLast[i].elapsed;
+      }
+      for (std::pair<const String,FurnaceGUIPerfStat>& i: perfStats) {
+        i.second.avg+=((double)i.second.cur-i.second.avg)*0.05;
+        if (i.second.cur>i.second.peak) i.second.peak=i.second.cur;
+      }
+    }
+
     eventTimeBegin=SDL_GetPerformanceCounter();
+    frameHadEvents=false;
     bool updateWindow=false;
     if (injectBackUp) {
       ImGui::GetIO().AddKeyEvent(ImGuiKey_Backspace,false);
@@ -3515,6 +3549,7 @@ bool FurnaceGUI::loop() {
     }
     while (SDL_PollEvent(&ev)) {
       WAKE_UP;
+      frameHadEvents=true;
       ImGui_ImplSDL2_ProcessEvent(&ev);
       processPoint(ev);
       if (!doThreadedInput) processEvent(&ev);
@@ -3540,6 +3575,7 @@ bool FurnaceGUI::loop() {
         case SDL_WINDOWEVENT:
           switch (ev.window.event) {
             case SDL_WINDOWEVENT_RESIZED:
+              lastDrawHash=0;
               scrW=ev.window.data1;
               scrH=ev.window.data2;
               portrait=(scrW<scrH);
@@ -3579,6 +3615,7 @@ bool FurnaceGUI::loop() {
               break;
             case SDL_WINDOWEVENT_EXPOSED:
               logV("window exposed");
+              lastDrawHash=0;
               break;
           }
           break;
@@ -3931,6 +3968,7 @@ bool FurnaceGUI::loop() {
     // recover from dead graphics
     if (rend->isDead() || killGraphics) {
       killGraphics=false;
+      lastDrawHash=0;
 
       logW("graphics are dead! restarting...");
       
@@ -3944,6 +3982,16 @@ bool FurnaceGUI::loop() {
         chanOscGradTex=NULL;
       }
 
+      if (chanOscTex!=NULL) {
+        rend->destroyTexture(chanOscTex);
+        chanOscTex=NULL;
+      }
+
+      if (waveThumbTex!=NULL) {
+        rend->destroyTexture(waveThumbTex);
+        waveThumbTex=NULL;
+      }
+
       for (auto& i: images) {
         if (i.second->tex!=NULL) {
           rend->destroyTexture(i.second->tex);
@@ -4500,7 +4548,7 @@ bool FurnaceGUI::loop() {
         bool hasInfo=false;
         String info;
         if (cursor.xCoarse>=0 && cursor.xCoarse<e->getTotalChannelCount()) {
-          DivPattern* p=e->curPat[cursor.xCoarse].getPattern(e->curOrders->ord[cursor.xCoarse][curOrder],false);
+          const DivPattern* p=e->curPat[cursor.xCoarse].getPattern(e->curOrders->ord[cursor.xCoarse][curOrder],false);
           if (cursor.xFine>=0) switch (cursor.xFine) {
             case 0: // note
               if (p->data[cursor.y][0]>0) {
@@ -5405,8 +5453,7 @@ bool FurnaceGUI::loop() {
       displayNew=false;
       if (settings.newSongBehavior==1) {
         e->createNewFromDefaults();
-        undoHist.clear();
-        redoHist.clear();
+        clearUndoHistory();
         curFileName="";
         modified=false;
         curNibble=false;
@@ -5452,6 +5499,15 @@ bool FurnaceGUI::loop() {
     centerNextWindow("Rendering...",canvasW,canvasH);
     if (ImGui::BeginPopupModal("Rendering...",NULL,ImGuiWindowFlags_AlwaysAutoResize)) {
       ImGui::Text("Please wait...");
+      double exportProgress, exportETA;
+      if (e->getExportProgress(exportProgress,exportETA)) {
+        String progressText=fmt::sprintf("%.0f%%",exportProgress*100.0);
+        if (exportETA>=0.0) {
+          int etaSec=(int)exportETA;
+          progressText+=fmt::sprintf(" (%d:%.2d left)",etaSec/60,etaSec%60);
+        }
+        ImGui::ProgressBar(exportProgress,ImVec2(300.0f*dpiScale,0),progressText.c_str());
+      }
       if (ImGui::Button("Abort")) {
         if (e->haltAudioFile()) {
           ImGui::CloseCurrentPopup();
@@ -5736,11 +5792,7 @@ bool FurnaceGUI::loop() {
               e->lockEngine([this]() {
                 for (int i=0; i<e->getTotalChannelCount(); i++) {
                   DivPattern* pat=e->curPat[i].getPattern(e->curOrders->ord[i][curOrder],true);
-                  memset(pat->data,-1,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
-                  for (int j=0; j<DIV_MAX_ROWS; j++) {
-                    pat->data[j][0]=0;
-                    pat->data[j][1]=0;
-                  }
+                  pat->clear();
                 }
               });
               MARK_MODIFIED;
@@ -5829,8 +5881,7 @@ bool FurnaceGUI::loop() {
         case GUI_WARN_SUBSONG_DEL:
           if (ImGui::Button("Yes")) {
             if (e->removeSubSong(e->getCurrentSubSong())) {
-              undoHist.clear();
-              redoHist.clear();
+              clearUndoHistory();
               updateScroll(0);
               oldRow=0;
               cursor.xCoarse=0;
@@ -6250,7 +6301,20 @@ bool FurnaceGUI::loop() {
               }
             }
             logD("saving backup...");
+            // saveFur() only holds the song lock while serializing.
+            // compression happens afterwards, outside of it.
             SafeWriter* w=e->saveFur(true,true);
+            if (w!=NULL && settings.compress) {
+              logV("compressing...");
+              SafeWriter* zw=e->compressFile(w->getFinalBuf(),w->size());
+              if (zw!=NULL) {
+                w->finish();
+                delete w;
+                w=zw;
+              } else {
+                logW("could not compress backup. saving it uncompressed.");
+              }
+            }
             logV("writing file...");
 
             if (w!=NULL) {
@@ -6308,6 +6372,7 @@ bool FurnaceGUI::loop() {
                 logW("could not save backup: %s!",strerror(errno));
               }
               w->finish();
+              delete w;
 
               // delete previous backup if there are too many
               delFirstBackup(backupBaseName);
@@ -6372,31 +6437,55 @@ bool FurnaceGUI::loop() {
       }
     }
 
-    if (!settings.renderClearPos) {
-      rend->clear(uiColors[GUI_COLOR_BACKGROUND]);
-    }
     renderTimeBegin=SDL_GetPerformanceCounter();
     ImGui::Render();
     renderTimeEnd=SDL_GetPerformanceCounter();
-    drawTimeBegin=SDL_GetPerformanceCounter();
-    rend->renderGUI();
-    if (mustClear) {
-      rend->clear(ImVec4(0,0,0,0));
-      mustClear--;
-      if (mustClear==0) e->everythingOK();
+
+    // skip drawing if the frame would look exactly like the last one
+    bool skipDraw=false;
+    if (settings.renderCache && !mustClear && !(initialScreenWipe>0.0f && !settings.disableFadeIn)) {
+      uint64_t drawHash=hashDrawData(ImGui::GetDrawData(),texUpdates^((uint64_t)ImGui::GetColorU32(uiColors[GUI_COLOR_BACKGROUND])<<32));
+      skipDraw=(drawHash!=0 && drawHash==lastDrawHash);
+      lastDrawHash=drawHash;
+    } else {
+      lastDrawHash=0;
+    }
+
+    if (skipDraw) {
+      skippedFrames++;
+      drawTimeBegin=SDL_GetPerformanceCounter();
+      drawTimeEnd=drawTimeBegin;
+      // there is no present to wait on, so pace the loop here
+      SDL_DisplayMode displayMode;
+      if (SDL_GetWindowDisplayMode(sdlWin,&displayMode)==0 && displayMode.refresh_rate>0) {
+        SDL_Delay(1000/displayMode.refresh_rate);
+      } else {
+        SDL_Delay(16);
+      }
     } else {
-      if (initialScreenWipe>0.0f && !settings.disableFadeIn) {
-        WAKE_UP;
-        initialScreenWipe-=ImGui::GetIO().DeltaTime*5.0f;
-        if (initialScreenWipe>0.0f) {
-          rend->wipe(pow(initialScreenWipe,2.0f));
+      if (!settings.renderClearPos) {
+        rend->clear(uiColors[GUI_COLOR_BACKGROUND]);
+      }
+      drawTimeBegin=SDL_GetPerformanceCounter();
+      rend->renderGUI();
+      if (mustClear) {
+        rend->clear(ImVec4(0,0,0,0));
+        mustClear--;
+        if (mustClear==0) e->everythingOK();
+      } else {
+        if (initialScreenWipe>0.0f && !settings.disableFadeIn) {
+          WAKE_UP;
+          initialScreenWipe-=ImGui::GetIO().DeltaTime*5.0f;
+          if (initialScreenWipe>0.0f) {
+            rend->wipe(pow(initialScreenWipe,2.0f));
+          }
         }
       }
-    }
-    drawTimeEnd=SDL_GetPerformanceCounter();
-    rend->present();
-    if (settings.renderClearPos) {
-      rend->clear(uiColors[GUI_COLOR_BACKGROUND]);
+      drawTimeEnd=SDL_GetPerformanceCounter();
+      rend->present();
+      if (settings.renderClearPos) {
+        rend->clear(uiColors[GUI_COLOR_BACKGROUND]);
+      }
     }
 
     layoutTimeDelta=layoutTimeEnd-layoutTimeBegin;
@@ -7230,9 +7319,25 @@ bool FurnaceGUI::finish() {
   }
 
   if (chanOscWorkPool!=NULL) {
+    chanOscWorkPool->wait();
     delete chanOscWorkPool;
   }
 
+  if (chanOscTexData!=NULL) {
+    delete[] chanOscTexData;
+    chanOscTexData=NULL;
+  }
+
+  if (waveThumbData!=NULL) {
+    delete[] waveThumbData;
+    waveThumbData=NULL;
+  }
+
+  if (sampleTexData!=NULL) {
+    delete[] sampleTexData;
+    sampleTexData=NULL;
+  }
+
   return true;
 }
 
@@ -7255,7 +7360,16 @@ FurnaceGUI::FurnaceGUI():
   sampleTex(NULL),
   sampleTexW(0),
   sampleTexH(0),
+  sampleTexData(NULL),
   updateSampleTex(true),
+  waveThumbTex(NULL),
+  waveThumbData(NULL),
+  waveThumbW(0),
+  waveThumbH(0),
+  waveThumbCols(0),
+  waveThumbRows(0),
+  waveThumbWantW(0),
+  waveThumbWantH(0),
   quit(false),
   warnQuit(false),
   willCommit(false),
@@ -7595,6 +7709,11 @@ FurnaceGUI::FurnaceGUI():
   eventTimeBegin(0),
   eventTimeEnd(0),
   eventTimeDelta(0),
+  lastDrawHash(0),
+  texUpdates(0),
+  skippedFrames(0),
+  lastVisFrame(0),
+  frameHadEvents(false),
   perfMetricsLen(0),
   chanToMove(-1),
   sysToMove(-1),
@@ -7688,6 +7807,10 @@ FurnaceGUI::FurnaceGUI():
   chanOscTextColor(1.0f,1.0f,1.0f,0.75f),
   chanOscGrad(64,64),
   chanOscGradTex(NULL),
+  chanOscTex(NULL),
+  chanOscTexW(0),
+  chanOscTexH(0),
+  chanOscTexData(NULL),
   chanOscWorkPool(NULL),
   xyOscPointTex(NULL),
   xyOscOptions(false),
@@ -7864,6 +7987,7 @@ FurnaceGUI::FurnaceGUI():
   memset(emptyLabel2,0,32);
   // effect sorting
   memset(effectsShow,1,sizeof(bool)*10);
+  memset(waveThumbKey,0,sizeof(uint64_t)*256);
 
   strncpy(noteOffLabel,"OFF",32);
   strncpy(noteRelLabel,"===",32);
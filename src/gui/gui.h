@@ -42,7 +42,7 @@
 #define handleUnimportant if (settings.insFocusesPattern && patternOpen) {nextWindow=GUI_WINDOW_PATTERN;}
 #define unimportant(x) if (x) {handleUnimportant}
 
-#define MARK_MODIFIED modified=true;
+#define MARK_MODIFIED modified=true; e->invalidateCommandStream();
 #define WAKE_UP drawHalt=16;
 
 #define RESET_WAVE_MACRO_ZOOM \
@@ -944,17 +944,31 @@ enum UndoOtherTarget {
   GUI_UNDO_TARGET_SUBSONG
 };
 
-struct UndoPatternData {
-  int subSong, chan, pat, row, col;
-  short oldVal, newVal;
-  UndoPatternData(int s, int c, int p, int r, int co, short v1, short v2):
+// a run of consecutive pattern cells (row*DIV_MAX_COLS+col) within one pattern.
+// the old and new values of each cell are stored in UndoStep::patVals.
+struct UndoPatternRun {
+  unsigned char subSong, chan, pat;
+  unsigned short start, len;
+  UndoPatternRun(int s, int c, int p, int st):
     subSong(s),
     chan(c),
     pat(p),
-    row(r),
-    col(co),
-    oldVal(v1),
-    newVal(v2) {}
+    start(st),
+    len(0) {}
+};
+
+// snapshot of the rows of a pattern taken by prepareUndo().
+struct UndoPatternSnapshot {
+  int rowBegin, rowEnd;
+  size_t off;
+  UndoPatternSnapshot(int b, int e, size_t o):
+    rowBegin(b),
+    rowEnd(e),
+    off(o) {}
+  UndoPatternSnapshot():
+    rowBegin(0),
+    rowEnd(-1),
+    off(0) {}
 };
 
 struct UndoOrderData {
@@ -989,9 +1003,22 @@ struct UndoStep {
   int oldOrdersLen, newOrdersLen;
   int oldPatLen, newPatLen;
   std::vector<UndoOrderData> ord;
-  std::vector<UndoPatternData> pat;
+  std::vector<UndoPatternRun> pat;
+  // old/new value pairs for every cell in pat
+  std::vector<short> patVals;
   std::vector<UndoOtherData> other;
 
+  /**
+   * record the differences between two versions of a pattern row.
+   * changed cells are appended to the last run when possible.
+   */
+  void diffPatternRow(int subSong, int chan, int pat, int row, const short* oldRow, const short* newRow);
+
+  /**
+   * get the approximate amount of memory used by this step.
+   */
+  size_t memUsage() const;
+
   UndoStep():
     type(GUI_UNDO_CHANGE_ORDER),
     cursor(),
@@ -1410,6 +1437,17 @@ struct FurnaceGUIPerfMetric {
     elapsed(0) {}
 };
 
+struct FurnaceGUIPerfStat {
+  // time spent in the current frame, moving average and peak
+  int cur;
+  double avg;
+  int peak;
+  FurnaceGUIPerfStat():
+    cur(0),
+    avg(0.0),
+    peak(0) {}
+};
+
 enum FurnaceGUIBlendMode {
   GUI_BLEND_MODE_NONE=0,
   GUI_BLEND_MODE_BLEND,
@@ -1476,8 +1514,18 @@ class FurnaceGUI {
   
   FurnaceGUITexture* sampleTex;
   int sampleTexW, sampleTexH;
+  unsigned int* sampleTexData;
   bool updateSampleTex;
 
+  // wave list thumbnail atlas (one cell per wavetable)
+  FurnaceGUITexture* waveThumbTex;
+  unsigned int* waveThumbData;
+  int waveThumbW, waveThumbH, waveThumbCols, waveThumbRows;
+  // size of the list items last drawn
+  int waveThumbWantW, waveThumbWantH;
+  uint64_t waveThumbKey[256];
+  std::vector<int> waveThumbPending;
+
   String workingDir, fileName, clipboard, warnString, errorString, lastError, curFileName, nextFile, sysSearchQuery, newSongQuery, paletteQuery;
   String workingDirSong, workingDirIns, workingDirWave, workingDirSample, workingDirAudioExport;
   String workingDirVGMExport, workingDirZSMExport, workingDirROMExport, workingDirFont, workingDirColors, workingDirKeybinds;
@@ -1684,6 +1732,7 @@ class FurnaceGUI {
     int oscEscapesBoundary;
     int oscMono;
     int oscAntiAlias;
+    int chanOscTexture;
     int separateFMColors;
     int insEditColorize;
     int metroVol;
@@ -1693,6 +1742,7 @@ class FurnaceGUI {
     int oplStandardWaveNames;
     int cursorMoveNoScroll;
     int lowLatency;
+    int precompiledPlayback;
     int notePreviewBehavior;
     int powerSave;
     int absorbInsInput;
@@ -1731,6 +1781,7 @@ class FurnaceGUI {
     int midiOutMode;
     int midiOutTimeRate;
     int maxRecentFile;
+    int maxUndoMemory;
     int centerPattern;
     int ordersCursor;
     int persistFadeOut;
@@ -1744,8 +1795,11 @@ class FurnaceGUI {
     int iCannotWait;
     int orderButtonPos;
     int compress;
+    int compressChunked;
     int newPatternFormat;
     int renderClearPos;
+    int renderCache;
+    int visualizerRate;
     int insertBehavior;
     int pullDeleteRow;
     int newSongBehavior;
@@ -1764,6 +1818,7 @@ class FurnaceGUI {
     int wasapiEx;
     int chanOscThreads;
     int renderPoolThreads;
+    int sampleFormatBudget;
     int showPool;
     int writeInsNames;
     int readInsNames;
@@ -1885,6 +1940,7 @@ class FurnaceGUI {
       oscEscapesBoundary(0),
       oscMono(1),
       oscAntiAlias(1),
+      chanOscTexture(1),
       separateFMColors(0),
       insEditColorize(0),
       metroVol(100),
@@ -1894,6 +1950,7 @@ class FurnaceGUI {
       oplStandardWaveNames(0),
       cursorMoveNoScroll(0),
       lowLatency(0),
+      precompiledPlayback(0),
       notePreviewBehavior(1),
       powerSave(1),
       absorbInsInput(0),
@@ -1931,6 +1988,7 @@ class FurnaceGUI {
       midiOutMode(1),
       midiOutTimeRate(0),
       maxRecentFile(10),
+      maxUndoMemory(64),
       centerPattern(0),
       ordersCursor(1),
       persistFadeOut(1),
@@ -1944,8 +2002,11 @@ class FurnaceGUI {
       iCannotWait(0),
       orderButtonPos(2),
       compress(1),
+      compressChunked(0),
       newPatternFormat(1),
       renderClearPos(0),
+      renderCache(0),
+      visualizerRate(0),
       insertBehavior(1),
       pullDeleteRow(1),
       newSongBehavior(0),
@@ -1964,6 +2025,7 @@ class FurnaceGUI {
       wasapiEx(0),
       chanOscThreads(0),
       renderPoolThreads(0),
+      sampleFormatBudget(0),
       showPool(0),
       writeInsNames(0),
       readInsNames(1),
@@ -2205,12 +2267,23 @@ class FurnaceGUI {
   uint64_t drawTimeBegin, drawTimeEnd, drawTimeDelta;
   uint64_t eventTimeBegin, eventTimeEnd, eventTimeDelta;
 
+  // render cache: hash of the last presented frame, texture update counter
+  uint64_t lastDrawHash;
+  unsigned int texUpdates;
+  int skippedFrames;
+
+  // playback frame pacing
+  uint64_t lastVisFrame;
+  bool frameHadEvents;
+
   FurnaceGUIPerfMetric perfMetrics[64];
   int perfMetricsLen;
 
   FurnaceGUIPerfMetric perfMetricsLast[64];
   int perfMetricsLastLen;
 
+  std::map<String,FurnaceGUIPerfStat> perfStats;
+
   std::map<FurnaceGUIImages,FurnaceGUIImage*> images;
 
   int chanToMove, sysToMove, sysToDelete, opToMove;
@@ -2230,7 +2303,8 @@ class FurnaceGUI {
 
   int oldOrdersLen;
   DivOrders oldOrders;
-  std::map<unsigned short,DivPattern*> oldPatMap;
+  std::map<unsigned short,UndoPatternSnapshot> oldPatMap;
+  std::vector<short> oldPatData;
   FixedQueue<UndoStep,256> undoHist;
   FixedQueue<UndoStep,256> redoHist;
 
@@ -2288,6 +2362,9 @@ class FurnaceGUI {
   ImVec4 chanOscColor, chanOscTextColor;
   Gradient2D chanOscGrad;
   FurnaceGUITexture* chanOscGradTex;
+  FurnaceGUITexture* chanOscTex;
+  int chanOscTexW, chanOscTexH;
+  unsigned int* chanOscTexData;
   DivWorkPool* chanOscWorkPool;
   float chanOscLP0[DIV_MAX_CHANS];
   float chanOscLP1[DIV_MAX_CHANS];
@@ -2299,13 +2376,14 @@ class FurnaceGUI {
     double* inBuf;
     fftw_complex* outBuf;
     double* corrBuf;
+    short* snapBuf;
     DivDispatchOscBuffer* relatedBuf;
     size_t inBufPos;
     double inBufPosFrac;
     double waveLen;
-    int waveLenBottom, waveLenTop, relatedCh;
-    float pitch, windowSize, phaseOff;
-    unsigned short needle;
+    int waveLenBottom, waveLenTop, relatedCh, snapLen, snapCap;
+    float pitch, windowSize, phaseOff, lastPhaseOff;
+    unsigned short needle, inNeedle;
     bool ready, loudEnough, waveCorr;
     fftw_plan plan;
     fftw_plan planI;
@@ -2313,6 +2391,7 @@ class FurnaceGUI {
       inBuf(NULL),
       outBuf(NULL),
       corrBuf(NULL),
+      snapBuf(NULL),
       relatedBuf(NULL),
       inBufPos(0),
       inBufPosFrac(0.0f),
@@ -2320,10 +2399,14 @@ class FurnaceGUI {
       waveLenBottom(0),
       waveLenTop(0),
       relatedCh(0),
+      snapLen(0),
+      snapCap(0),
       pitch(0.0f),
       windowSize(1.0f),
       phaseOff(0.0f),
+      lastPhaseOff(0.0f),
       needle(0),
+      inNeedle(0),
       ready(false),
       loudEnough(false),
       waveCorr(false),
@@ -2483,6 +2566,7 @@ class FurnaceGUI {
   float calcBPM(const DivGroovePattern& speeds, float hz, int vN, int vD);
 
   void patternRow(int i, bool isPlaying, float lineHeight, int chans, int ord, const DivPattern** patCache, bool inhibitSel);
+  void patternRows(int start, int count, bool isPlaying, float lineHeight, int chans, int ord, const DivPattern** patCache, bool inhibitSel);
 
   void drawMacroEdit(FurnaceGUIMacroDesc& i, int totalFit, float availableWidth, int index);
   void drawMacros(std::vector<FurnaceGUIMacroDesc>& macros, FurnaceGUIMacroEditState& state);
@@ -2496,7 +2580,10 @@ class FurnaceGUI {
   void actualSampleList();
 
   void insListItem(int index, int dir, int asset);
-  void waveListItem(int index, float* wavePreview, int dir, int asset);
+  void waveListItem(int index, int dir, int asset);
+  void prepareWaveThumbs();
+  void drawWaveThumb(int index, const ImVec2& size);
+  void flushWaveThumbs();
   void sampleListItem(int index, int dir, int asset);
 
   void toggleMobileUI(bool enable, bool force=false);
@@ -2592,6 +2679,9 @@ class FurnaceGUI {
   void editAdvance();
   void prepareUndo(ActionType action, UndoRegion region=UndoRegion());
   void makeUndo(ActionType action, UndoRegion region=UndoRegion());
+  void pushUndo(const UndoStep& us);
+  void clearUndoHistory();
+  void applyUndoPattern(const UndoStep& us, bool redo);
   void doSelectAll();
   void doDelete();
   void doPullDelete();
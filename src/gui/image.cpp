@@ -61,6 +61,7 @@ FurnaceGUITexture* FurnaceGUI::getTexture(FurnaceGUIImages image, FurnaceGUIBlen
     }
     rend->setTextureBlendMode(img->tex,blendMode);
 
+    texUpdates++;
     if (!rend->updateTexture(img->tex,img->data,img->width*4)) {
       logE("error while updating texture of image %d! %s",(int)image,SDL_GetError());
     }
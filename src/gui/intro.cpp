@@ -86,8 +86,7 @@ void FurnaceGUI::endIntroTune() {
       e->createNewFromDefaults();
     }
   }
-  undoHist.clear();
-  redoHist.clear();
+  clearUndoHistory();
   modified=false;
   curNibble=false;
   orderNibble=false;
@@ -174,8 +174,7 @@ void FurnaceGUI::drawNewSong() {
 
   if (accepted) {
     e->createNew(nextDesc.c_str(),nextDescName,false);
-    undoHist.clear();
-    redoHist.clear();
+    clearUndoHistory();
     curFileName="";
     modified=false;
     curNibble=false;
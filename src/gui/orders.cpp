@@ -318,7 +318,7 @@ void FurnaceGUI::drawOrders() {
           for (int j=0; j<e->getTotalChannelCount(); j++) {
             if (!e->curSubSong->chanShow[j]) continue;
             ImGui::TableNextColumn();
-            DivPattern* pat=e->curPat[j].getPattern(e->curOrders->ord[j][i],false);
+            const DivPattern* pat=e->curPat[j].getPattern(e->curOrders->ord[j][i],false);
             /*if (!pat->name.empty()) {
               snprintf(selID,4096,"%s##O_%.2x_%.2x",pat->name.c_str(),j,i);
             } else {*/
@@ -68,17 +68,66 @@ void FurnaceGUI::popPartBlend() {
   rend->setBlendMode(GUI_BLEND_MODE_BLEND);
 }
 
+// precomputed cell labels, so that visible cells don't have to be formatted every frame
+static char cellLabelHex[256][4];
+static char cellLabelHexOne[16][4];
+static bool cellLabelsReady=false;
+
+static void prepareCellLabels() {
+  if (cellLabelsReady) return;
+  for (int i=0; i<256; i++) {
+    snprintf(cellLabelHex[i],4,"%.2X",i);
+  }
+  for (int i=0; i<16; i++) {
+    snprintf(cellLabelHexOne[i],4," %.1X",i);
+  }
+  cellLabelsReady=true;
+}
+
+// returns a two-digit label for a cell value, formatting into buf only for out-of-range values
+static inline const char* cellLabel(short val, char* buf) {
+  if (val>=0 && val<256) return cellLabelHex[val];
+  snprintf(buf,16,"%.2X",val);
+  return buf;
+}
+
+// cells are identified by position rather than by label
+#define PAT_CELL_ID(_i,_j,_f) (((_i)<<13)|((_j)<<5)|(_f))
+
+// draw a range of pattern rows
+// runs of rows outside of the visible area are collapsed into a single tall row.
+void FurnaceGUI::patternRows(int start, int count, bool isPlaying, float lineHeight, int chans, int ord, const DivPattern** patCache, bool inhibitSel) {
+  float viewHeight=ImGui::GetWindowSize().y;
+  int i=0;
+  while (i<count) {
+    ImGui::TableNextRow(0,lineHeight);
+    ImGui::TableNextColumn();
+    float cursorPosY=ImGui::GetCursorPos().y-ImGui::GetScrollY();
+    if (cursorPosY>viewHeight) {
+      // everything from here on is below the visible area
+      if (count-i>1) ImGui::Dummy(ImVec2(1.0f,lineHeight*(float)(count-i)));
+      break;
+    }
+    if (cursorPosY<-lineHeight) {
+      // skip rows above the visible area
+      int skip=(int)((-lineHeight-cursorPosY)/lineHeight);
+      if (skip<1) skip=1;
+      if (skip>count-i) skip=count-i;
+      if (skip>1) ImGui::Dummy(ImVec2(1.0f,lineHeight*(float)skip));
+      i+=skip;
+      continue;
+    }
+    patternRow(start+i,isPlaying,lineHeight,chans,ord,patCache,inhibitSel);
+    i++;
+  }
+}
+
 // draw a pattern row
+// the row must have been started already.
 inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int chans, int ord, const DivPattern** patCache, bool inhibitSel) {
   static char id[64];
+  char valBuf[16];
   bool selectedRow=(i>=sel1.y && i<=sel2.y && !inhibitSel);
-  ImGui::TableNextRow(0,lineHeight);
-  ImGui::TableNextColumn();
-  float cursorPosY=ImGui::GetCursorPos().y-ImGui::GetScrollY();
-  // check if the row is visible
-  if (cursorPosY<-lineHeight || cursorPosY>ImGui::GetWindowSize().y) {
-    return;
-  }
   // check if we are in range
   if (ord<0 || ord>=e->curSubSong->ordersLen) {
     return;
@@ -159,15 +208,24 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
     if (!e->curSubSong->chanShow[j]) {
       continue;
     }
-    int chanVolMax=e->getMaxVolumeChan(j);
-    if (chanVolMax<1) chanVolMax=1;
-    const DivPattern* pat=patCache[j];
-    ImGui::TableNextColumn();
+    bool chanVisible=ImGui::TableNextColumn();
     for (int k=mustSetXOf; k<=j; k++)  {
       patChanX[k]=ImGui::GetCursorScreenPos().x;
     }
     mustSetXOf=j+1;
 
+    // skip channels which are scrolled out of view
+    if (!chanVisible) {
+      if (cursor.y==i && cursor.xCoarse==j && curWindowLast==GUI_WINDOW_PATTERN) {
+        demandX=ImGui::GetCursorPosX();
+      }
+      continue;
+    }
+
+    int chanVolMax=e->getMaxVolumeChan(j);
+    if (chanVolMax<1) chanVolMax=1;
+    const DivPattern* pat=patCache[j];
+
     // selection highlight flags
     int sel1XSum=sel1.xCoarse*32+sel1.xFine;
     int sel2XSum=sel2.xCoarse*32+sel2.xFine;
@@ -180,24 +238,26 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
     bool cursorVol=(cursor.y==i && cursor.xCoarse==j && cursor.xFine==2 && curWindowLast==GUI_WINDOW_PATTERN);
 
     // note
-    snprintf(id,63,"%.31s##PN_%d_%d",noteName(pat->data[i][0],pat->data[i][1]),i,j);
+    const char* noteLabel=noteName(pat->data[i][0],pat->data[i][1]);
     if (pat->data[i][0]==0 && pat->data[i][1]==0) {
       ImGui::PushStyleColor(ImGuiCol_Text,inactiveColor);
     } else {
       ImGui::PushStyleColor(ImGuiCol_Text,activeColor);
     }
+    ImGui::PushID(PAT_CELL_ID(i,j,0));
     if (cursorNote) {
       ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_CURSOR]);
       ImGui::PushStyleColor(ImGuiCol_HeaderActive,uiColors[GUI_COLOR_PATTERN_CURSOR_ACTIVE]);
       ImGui::PushStyleColor(ImGuiCol_HeaderHovered,uiColors[GUI_COLOR_PATTERN_CURSOR_HOVER]);
-      ImGui::Selectable(id,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,noteCellSize);
+      ImGui::Selectable(noteLabel,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,noteCellSize);
       demandX=ImGui::GetCursorPosX();
       ImGui::PopStyleColor(3);
     } else {
       if (selectedNote) ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_SELECTION]);
-      ImGui::Selectable(id,isPushing || selectedNote,ImGuiSelectableFlags_NoPadWithHalfSpacing,noteCellSize);
+      ImGui::Selectable(noteLabel,isPushing || selectedNote,ImGuiSelectableFlags_NoPadWithHalfSpacing,noteCellSize);
       if (selectedNote) ImGui::PopStyleColor();
     }
+    ImGui::PopID();
     if (ImGui::IsItemClicked()) {
       startSelection(j,0,i);
     }
@@ -213,9 +273,10 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
     // the following is only visible when the channel is not collapsed
     if (e->curSubSong->chanCollapse[j]<3) {
       // instrument
+      const char* insLabel;
       if (pat->data[i][2]==-1) {
         ImGui::PushStyleColor(ImGuiCol_Text,inactiveColor);
-        snprintf(id,63,"%.31s##PI_%d_%d",emptyLabel2,i,j);
+        insLabel=emptyLabel2;
       } else {
         if (pat->data[i][2]<0 || pat->data[i][2]>=e->song.insLen) {
           ImGui::PushStyleColor(ImGuiCol_Text,uiColors[GUI_COLOR_PATTERN_INS_ERROR]);
@@ -227,21 +288,23 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
             ImGui::PushStyleColor(ImGuiCol_Text,uiColors[GUI_COLOR_PATTERN_INS]);
           }
         }
-        snprintf(id,63,"%.2X##PI_%d_%d",pat->data[i][2],i,j);
+        insLabel=cellLabel(pat->data[i][2],valBuf);
       }
       ImGui::SameLine(0.0f,0.0f);
+      ImGui::PushID(PAT_CELL_ID(i,j,1));
       if (cursorIns) {
         ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_CURSOR]);
         ImGui::PushStyleColor(ImGuiCol_HeaderActive,uiColors[GUI_COLOR_PATTERN_CURSOR_ACTIVE]);
         ImGui::PushStyleColor(ImGuiCol_HeaderHovered,uiColors[GUI_COLOR_PATTERN_CURSOR_HOVER]);
-        ImGui::Selectable(id,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,insCellSize);
+        ImGui::Selectable(insLabel,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,insCellSize);
         demandX=ImGui::GetCursorPosX();
         ImGui::PopStyleColor(3);
       } else {
         if (selectedIns) ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_SELECTION]);
-        ImGui::Selectable(id,isPushing || selectedIns,ImGuiSelectableFlags_NoPadWithHalfSpacing,insCellSize);
+        ImGui::Selectable(insLabel,isPushing || selectedIns,ImGuiSelectableFlags_NoPadWithHalfSpacing,insCellSize);
         if (selectedIns) ImGui::PopStyleColor();
       }
+      ImGui::PopID();
       if (ImGui::IsItemClicked()) {
         startSelection(j,1,i);
       }
@@ -257,29 +320,32 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
 
     if (e->curSubSong->chanCollapse[j]<2) {
       // volume
+      const char* volLabel;
       if (pat->data[i][3]==-1) {
-        snprintf(id,63,"%.31s##PV_%d_%d",emptyLabel2,i,j);
+        volLabel=emptyLabel2;
         ImGui::PushStyleColor(ImGuiCol_Text,inactiveColor);
       } else {
         int volColor=(pat->data[i][3]*127)/chanVolMax;
         if (volColor>127) volColor=127;
         if (volColor<0) volColor=0;
-        snprintf(id,63,"%.2X##PV_%d_%d",pat->data[i][3],i,j);
+        volLabel=cellLabel(pat->data[i][3],valBuf);
         ImGui::PushStyleColor(ImGuiCol_Text,volColors[volColor]);
       }
       ImGui::SameLine(0.0f,0.0f);
+      ImGui::PushID(PAT_CELL_ID(i,j,2));
       if (cursorVol) {
         ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_CURSOR]);
         ImGui::PushStyleColor(ImGuiCol_HeaderActive,uiColors[GUI_COLOR_PATTERN_CURSOR_ACTIVE]);
         ImGui::PushStyleColor(ImGuiCol_HeaderHovered,uiColors[GUI_COLOR_PATTERN_CURSOR_HOVER]);
-        ImGui::Selectable(id,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,volCellSize);
+        ImGui::Selectable(volLabel,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,volCellSize);
         demandX=ImGui::GetCursorPosX();
         ImGui::PopStyleColor(3);
       } else {
         if (selectedVol) ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_SELECTION]);
-        ImGui::Selectable(id,isPushing || selectedVol,ImGuiSelectableFlags_NoPadWithHalfSpacing,volCellSize);
+        ImGui::Selectable(volLabel,isPushing || selectedVol,ImGuiSelectableFlags_NoPadWithHalfSpacing,volCellSize);
         if (selectedVol) ImGui::PopStyleColor();
       }
+      ImGui::PopID();
       if (ImGui::IsItemClicked()) {
         startSelection(j,2,i);
       }
@@ -303,36 +369,39 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
         bool cursorEffectVal=(cursor.y==i && cursor.xCoarse==j && cursor.xFine==index && curWindowLast==GUI_WINDOW_PATTERN);
         
         // effect
+        const char* fxLabel;
         if (pat->data[i][index]==-1) {
-          snprintf(id,63,"%.31s##PE%d_%d_%d",emptyLabel2,k,i,j);
+          fxLabel=emptyLabel2;
           ImGui::PushStyleColor(ImGuiCol_Text,inactiveColor);
         } else {
           if (pat->data[i][index]>0xff) {
-            snprintf(id,63,"??##PE%d_%d_%d",k,i,j);
+            fxLabel="??";
             ImGui::PushStyleColor(ImGuiCol_Text,uiColors[GUI_COLOR_PATTERN_EFFECT_INVALID]);
           } else if (pat->data[i][index]>=0x10 || settings.oneDigitEffects==0) {
             const unsigned char data=pat->data[i][index];
-            snprintf(id,63,"%.2X##PE%d_%d_%d",data,k,i,j);
+            fxLabel=cellLabelHex[data];
             ImGui::PushStyleColor(ImGuiCol_Text,uiColors[fxColors[data]]);
           } else {
             const unsigned char data=pat->data[i][index];
-            snprintf(id,63," %.1X##PE%d_%d_%d",data,k,i,j);
+            fxLabel=cellLabelHexOne[data];
             ImGui::PushStyleColor(ImGuiCol_Text,uiColors[fxColors[data]]);
           }
         }
         ImGui::SameLine(0.0f,0.0f);
+        ImGui::PushID(PAT_CELL_ID(i,j,index-1));
         if (cursorEffect) {
           ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_CURSOR]);  
           ImGui::PushStyleColor(ImGuiCol_HeaderActive,uiColors[GUI_COLOR_PATTERN_CURSOR_ACTIVE]);
           ImGui::PushStyleColor(ImGuiCol_HeaderHovered,uiColors[GUI_COLOR_PATTERN_CURSOR_HOVER]);
-          ImGui::Selectable(id,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectCellSize);
+          ImGui::Selectable(fxLabel,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectCellSize);
           demandX=ImGui::GetCursorPosX();
           ImGui::PopStyleColor(3);
         } else {
           if (selectedEffect) ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_SELECTION]);
-          ImGui::Selectable(id,isPushing || selectedEffect,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectCellSize);
+          ImGui::Selectable(fxLabel,isPushing || selectedEffect,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectCellSize);
           if (selectedEffect) ImGui::PopStyleColor();
         }
+        ImGui::PopID();
         if (ImGui::IsItemClicked()) {
           startSelection(j,index-1,i);
         }
@@ -345,24 +414,27 @@ inline void FurnaceGUI::patternRow(int i, bool isPlaying, float lineHeight, int
         }
 
         // effect value
+        const char* fxValLabel;
         if (pat->data[i][index+1]==-1) {
-          snprintf(id,63,"%.31s##PF%d_%d_%d",emptyLabel2,k,i,j);
+          fxValLabel=emptyLabel2;
         } else {
-          snprintf(id,63,"%.2X##PF%d_%d_%d",pat->data[i][index+1],k,i,j);
+          fxValLabel=cellLabel(pat->data[i][index+1],valBuf);
         }
         ImGui::SameLine(0.0f,0.0f);
+        ImGui::PushID(PAT_CELL_ID(i,j,index));
         if (cursorEffectVal) {
           ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_CURSOR]);  
           ImGui::PushStyleColor(ImGuiCol_HeaderActive,uiColors[GUI_COLOR_PATTERN_CURSOR_ACTIVE]);
           ImGui::PushStyleColor(ImGuiCol_HeaderHovered,uiColors[GUI_COLOR_PATTERN_CURSOR_HOVER]);
-          ImGui::Selectable(id,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectValCellSize);
+          ImGui::Selectable(fxValLabel,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectValCellSize);
           demandX=ImGui::GetCursorPosX();
           ImGui::PopStyleColor(3);
         } else {
           if (selectedEffectVal) ImGui::PushStyleColor(ImGuiCol_Header,uiColors[GUI_COLOR_PATTERN_SELECTION]);
-          ImGui::Selectable(id,isPushing || selectedEffectVal,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectValCellSize);
+          ImGui::Selectable(fxValLabel,isPushing || selectedEffectVal,ImGuiSelectableFlags_NoPadWithHalfSpacing,effectValCellSize);
           if (selectedEffectVal) ImGui::PopStyleColor();
         }
+        ImGui::PopID();
         if (ImGui::IsItemClicked()) {
           startSelection(j,index,i);
         }
@@ -394,6 +466,7 @@ void FurnaceGUI::drawPattern() {
     nextWindow=GUI_WINDOW_NOTHING;
   }
   if (!patternOpen) return;
+  prepareCellLabels();
 
   bool inhibitMenu=false;
 
@@ -1128,9 +1201,7 @@ void FurnaceGUI::drawPattern() {
         if ((ord-1)>=0) for (int i=0; i<chans; i++) {
           patCache[i]=e->curPat[i].getPattern(e->curOrders->ord[i][ord-1],true);
         }
-        for (int i=0; i<dummyRows-1; i++) {
-          patternRow(e->curSubSong->patLen+i-dummyRows+1,e->isPlaying(),lineHeight,chans,ord-1,patCache,true);
-        }
+        patternRows(e->curSubSong->patLen-dummyRows+1,dummyRows-1,e->isPlaying(),lineHeight,chans,ord-1,patCache,true);
       } else {
         for (int i=0; i<dummyRows-1; i++) {
           ImGui::TableNextRow(0,lineHeight);
@@ -1142,18 +1213,14 @@ void FurnaceGUI::drawPattern() {
       for (int i=0; i<chans; i++) {
         patCache[i]=e->curPat[i].getPattern(e->curOrders->ord[i][ord],true);
       }
-      for (int i=0; i<e->curSubSong->patLen; i++) {
-        patternRow(i,e->isPlaying(),lineHeight,chans,ord,patCache,false);
-      }
+      patternRows(0,e->curSubSong->patLen,e->isPlaying(),lineHeight,chans,ord,patCache,false);
       // next pattern
       ImGui::BeginDisabled();
       if (settings.viewPrevPattern) {
         if ((ord+1)<e->curSubSong->ordersLen) for (int i=0; i<chans; i++) {
           patCache[i]=e->curPat[i].getPattern(e->curOrders->ord[i][ord+1],true);
         }
-        for (int i=0; i<=dummyRows; i++) {
-          patternRow(i,e->isPlaying(),lineHeight,chans,ord+1,patCache,true);
-        }
+        patternRows(0,dummyRows+1,e->isPlaying(),lineHeight,chans,ord+1,patCache,true);
       } else {
         for (int i=0; i<=dummyRows; i++) {
           ImGui::TableNextRow(0,lineHeight);
@@ -28,11 +28,21 @@ void FurnaceGUI::drawRegView() {
   }
   if (!regViewOpen) return;
   if (ImGui::Begin("Register View",&regViewOpen,globalWinFlags)) {
+    // use the snapshot taken by the audio thread if there is one
+    const DivDebugSnapshot* snap=e->getDebugSnapshot();
     for (int i=0; i<e->song.systemLen; i++) {
       ImGui::Text("%d. %s",i+1,getSystemName(e->song.system[i]));
       int size=0;
       int depth=8;
-      unsigned char* regPool=e->getRegisterPool(i,size,depth);
+      unsigned char* regPool=NULL;
+      if (snap!=NULL && i<snap->systemLen && snap->regPool[i]!=NULL) {
+        regPool=snap->regPool[i];
+        size=snap->regPoolSize[i];
+        depth=snap->regPoolDepth[i];
+      } else {
+        // no snapshot yet, or it was captured before there was room for this chip
+        regPool=e->getRegisterPool(i,size,depth);
+      }
       unsigned short* regPoolW=(unsigned short*)regPool;
       if (regPool==NULL) {
         ImGui::Text("- no register pool available");
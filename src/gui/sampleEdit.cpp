@@ -1455,6 +1455,10 @@ void FurnaceGUI::drawSampleEdit() {
           rend->destroyTexture(sampleTex);
           sampleTex=NULL;
         }
+        if (sampleTexData!=NULL) {
+          delete[] sampleTexData;
+          sampleTexData=NULL;
+        }
         if (avail.x>=1 && avail.y>=1) {
           logD("recreating sample texture.");
           sampleTex=rend->createTexture(true,avail.x,avail.y);
@@ -1463,6 +1467,7 @@ void FurnaceGUI::drawSampleEdit() {
           if (sampleTex==NULL) {
             logE("error while creating sample texture! %s",SDL_GetError());
           } else {
+            sampleTexData=new unsigned int[sampleTexW*sampleTexH];
             updateSampleTex=true;
           }
         }
@@ -1470,107 +1475,55 @@ void FurnaceGUI::drawSampleEdit() {
 
       if (sampleTex!=NULL) {
         if (updateSampleTex) {
-          unsigned int* dataT=NULL;
-          int pitch=0;
+          unsigned int* data=sampleTexData;
           logD("updating sample texture.");
-          if (!rend->lockTexture(sampleTex,(void**)&dataT,&pitch)) {
-            logE("error while locking sample texture! %s",SDL_GetError());
-          } else {
-            unsigned int* data=new unsigned int[sampleTexW*sampleTexH];
-
-            ImU32 bgColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_BG]);
-            ImU32 bgColorLoop=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_LOOP]);
-            ImU32 lineColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_FG]);
-            ImU32 centerLineColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_CENTER]);
-            int ij=0;
-            for (int i=0; i<availY; i++) {
-              for (int j=0; j<availX; j++) {
-                int scaledPos=samplePos+(j*sampleZoom);
-                if (sample->isLoopable() && (scaledPos>=sample->loopStart && scaledPos<=sample->loopEnd)) {
-                  data[ij++]=bgColorLoop;
-                } else {
-                  data[ij++]=bgColor;
-                }
+
+          ImU32 bgColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_BG]);
+          ImU32 bgColorLoop=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_LOOP]);
+          ImU32 lineColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_FG]);
+          ImU32 centerLineColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_CENTER]);
+          int ij=0;
+          for (int i=0; i<availY; i++) {
+            for (int j=0; j<availX; j++) {
+              int scaledPos=samplePos+(j*sampleZoom);
+              if (sample->isLoopable() && (scaledPos>=sample->loopStart && scaledPos<=sample->loopEnd)) {
+                data[ij++]=bgColorLoop;
+              } else {
+                data[ij++]=bgColor;
               }
             }
-            if (availY>0) {
-              for (int i=availX*(availY>>1); i<availX*(1+(availY>>1)); i++) {
-                data[i]=centerLineColor;
-              }
+          }
+          if (availY>0) {
+            for (int i=availX*(availY>>1); i<availX*(1+(availY>>1)); i++) {
+              data[i]=centerLineColor;
             }
-            unsigned int xCoarse=samplePos;
-            unsigned int xFine=0;
-            unsigned int xAdvanceCoarse=sampleZoom;
-            unsigned int xAdvanceFine=fmod(sampleZoom,1.0)*16777216;
-            for (unsigned int i=0; i<(unsigned int)availX; i++) {
-              if (xCoarse>=sample->samples) break;
-              int y1, y2;
-              int candMin=INT_MAX;
-              int candMax=INT_MIN;
-              int totalAdvance=0;
-              if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                if (candMin>sample->data8[xCoarse]) candMin=sample->data8[xCoarse];
-                if (candMax<sample->data8[xCoarse]) candMax=sample->data8[xCoarse];
-              } else {
-                if (candMin>sample->data16[xCoarse]) candMin=sample->data16[xCoarse];
-                if (candMax<sample->data16[xCoarse]) candMax=sample->data16[xCoarse];
-              }
-              xFine+=xAdvanceFine;
-              if (xFine>=16777216) {
-                xFine-=16777216;
-                totalAdvance++;
-              }
-              totalAdvance+=xAdvanceCoarse;
-              if (xCoarse>=sample->samples) break;
-              do {
-                if (xCoarse>=sample->samples) break;
-                if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                  if (candMin>sample->data8[xCoarse]) candMin=sample->data8[xCoarse];
-                  if (candMax<sample->data8[xCoarse]) candMax=sample->data8[xCoarse];
-                } else {
-                  if (candMin>sample->data16[xCoarse]) candMin=sample->data16[xCoarse];
-                  if (candMax<sample->data16[xCoarse]) candMax=sample->data16[xCoarse];
-                }
-                if (totalAdvance>0) xCoarse++;
-              } while ((totalAdvance--)>0);
-              if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                y1=(((unsigned char)candMin^0x80)*availY)>>8;
-                y2=(((unsigned char)candMax^0x80)*availY)>>8;
-              } else {
-                y1=(((unsigned short)candMin^0x8000)*availY)>>16;
-                y2=(((unsigned short)candMax^0x8000)*availY)>>16;
-              }
-              if (y1>y2) {
-                y2^=y1;
-                y1^=y2;
-                y2^=y1;
-              }
-              if (y1<0) y1=0;
-              if (y1>=availY) y1=availY-1;
-              if (y2<0) y2=0;
-              if (y2>=availY) y2=availY-1;
-
-              const int s1=i+availX*(availY-y1-1);
-              const int s2=i+availX*(availY-y2-1);
-
-              for (int j=s2; j<=s1; j+=availX) {
-                data[j]=lineColor;
-              }
+          }
+          // each column covers the samples under it plus the first one of the next column.
+          // the peak pyramid keeps this proportional to the width rather than the sample count.
+          for (unsigned int i=0; i<(unsigned int)availX; i++) {
+            unsigned int start=samplePos+(unsigned int)((double)i*sampleZoom);
+            unsigned int end=samplePos+(unsigned int)((double)(i+1)*sampleZoom)+1;
+            if (start>=sample->samples) break;
+            short candMin, candMax;
+            if (!sample->getPeak(start,end,candMin,candMax)) break;
+            int y1=(((unsigned short)candMin^0x8000)*availY)>>16;
+            int y2=(((unsigned short)candMax^0x8000)*availY)>>16;
+            if (y1<0) y1=0;
+            if (y1>=availY) y1=availY-1;
+            if (y2<0) y2=0;
+            if (y2>=availY) y2=availY-1;
+
+            const int s1=i+availX*(availY-y1-1);
+            const int s2=i+availX*(availY-y2-1);
+
+            for (int j=s2; j<=s1; j+=availX) {
+              data[j]=lineColor;
             }
+          }
 
-            if ((pitch>>2)==sampleTexW) {
-              memcpy(dataT,data,sampleTexW*sampleTexH*sizeof(unsigned int));
-            } else {
-              int srcY=0;
-              int destY=0;
-              for (int i=0; i<sampleTexH; i++) {
-                memcpy(&dataT[destY],&data[srcY],sampleTexW*sizeof(unsigned int));
-                srcY+=sampleTexW;
-                destY+=pitch>>2;
-              }
-            }
-            rend->unlockTexture(sampleTex);
-            delete[] data;
+          texUpdates++;
+          if (!rend->updateTexture(sampleTex,data,sampleTexW*4)) {
+            logE("error while updating sample texture! %s",SDL_GetError());
           }
           updateSampleTex=false;
         }
@@ -413,6 +413,24 @@ void FurnaceGUI::drawSettings() {
           ImGui::SetTooltip("calls rend->clear() after rend->present(). might reduce UI latency by one frame in some drivers.");
         }
 
+        bool renderCacheB=settings.renderCache;
+        if (ImGui::Checkbox("Skip drawing unchanged frames",&renderCacheB)) {
+          settings.renderCache=renderCacheB;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("does not draw or present a frame if it would look exactly like the previous one.\nreduces CPU usage when idle, especially with software rendering.");
+        }
+
+        if (ImGui::InputInt("Visualization rate during playback (0 = display rate)",&settings.visualizerRate)) {
+          if (settings.visualizerRate<0) settings.visualizerRate=0;
+          if (settings.visualizerRate>240) settings.visualizerRate=240;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("limits how often the interface is redrawn during playback when there is no input.\noscilloscopes, meters and the pattern view update at this rate.\ninput is always handled immediately.");
+        }
+
         bool powerSaveB=settings.powerSave;
         if (ImGui::Checkbox("Power-saving mode",&powerSaveB)) {
           settings.powerSave=powerSaveB;
@@ -486,7 +504,20 @@ void FurnaceGUI::drawSettings() {
           settingsChanged=true;
         }
         if (ImGui::IsItemHovered()) {
-          ImGui::SetTooltip("use zlib to compress saved songs.");
+          ImGui::SetTooltip("use zlib to compress saved songs and backups.\nuses multiple threads if multi-threading is enabled.");
+        }
+
+        if (settings.compress) {
+          ImGui::Indent();
+          bool compressChunkedB=settings.compressChunked;
+          if (ImGui::Checkbox("Compress samples and sub-songs separately",&compressChunkedB)) {
+            settings.compressChunked=compressChunkedB;
+            settingsChanged=true;
+          }
+          if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("saves in a chunked format which can be loaded faster and partially (e.g. song info without samples).\nthe file will be slightly larger.\n\nwarning: older versions of Furnace can't open these files!");
+          }
+          ImGui::Unindent();
         }
 
         bool saveUnusedPatternsB=settings.saveUnusedPatterns;
@@ -834,6 +865,15 @@ void FurnaceGUI::drawSettings() {
           settingsChanged=true;
         }
 
+        if (ImGui::InputInt("Undo history memory limit (MB)",&settings.maxUndoMemory,1,16)) {
+          if (settings.maxUndoMemory<1) settings.maxUndoMemory=1;
+          if (settings.maxUndoMemory>4096) settings.maxUndoMemory=4096;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("the oldest undo steps are forgotten once pattern undo history uses more than this amount of memory.");
+        }
+
         END_SECTION;
       }
       CONFIG_SECTION("Audio") {
@@ -1006,7 +1046,7 @@ void FurnaceGUI::drawSettings() {
             settingsChanged=true;
           }
           if (ImGui::IsItemHovered()) {
-            ImGui::SetTooltip("runs chip emulation on separate threads.\nmay increase performance when using heavy emulation cores.\n\nwarnings:\n- experimental!\n- only useful on multi-chip songs.");
+            ImGui::SetTooltip("runs chip emulation on separate threads.\nmay increase performance when using heavy emulation cores.\nsamples are also converted in parallel when this is on.\n\nwarnings:\n- experimental!\n- only useful on multi-chip songs.");
           }
 
           if (renderPoolThreadsB) {
@@ -1038,6 +1078,15 @@ void FurnaceGUI::drawSettings() {
           ImGui::SetTooltip("reduces latency by running the engine faster than the tick rate.\nuseful for live playback/jam mode.\n\nwarning: only enable if your buffer size is small (10ms or less).");
         }
 
+        bool precompiledPlaybackB=settings.precompiledPlayback;
+        if (ImGui::Checkbox("Play from precompiled command stream (EXPERIMENTAL)",&precompiledPlaybackB)) {
+          settings.precompiledPlayback=precompiledPlaybackB;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("compiles the song into a command stream when playback starts, and plays that instead of the patterns.\nthis reduces playback cost, but the song is always played from the beginning and edits are not heard until the next play.");
+        }
+
         bool forceMonoB=settings.forceMono;
         if (ImGui::Checkbox("Force mono audio",&forceMonoB)) {
           settings.forceMono=forceMonoB;
@@ -1622,6 +1671,18 @@ void FurnaceGUI::drawSettings() {
         ImGui::SameLine();
         if (ImGui::Combo("##PCSOutMethod",&settings.pcSpeakerOutMethod,pcspkrOutMethods,5)) settingsChanged=true;
 
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text("Unused sample data limit (MB)");
+        ImGui::SameLine();
+        if (ImGui::InputInt("##SampleFormatBudget",&settings.sampleFormatBudget)) {
+          if (settings.sampleFormatBudget<0) settings.sampleFormatBudget=0;
+          if (settings.sampleFormatBudget>16384) settings.sampleFormatBudget=16384;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("samples are converted to the formats of every chip in the song.\nconverted data which no chip needs anymore is freed once it takes more memory than this.\n0 means no limit.");
+        }
+
         /*
         ImGui::Separator();
         ImGui::Text("Sample ROMs:");
@@ -3172,6 +3233,15 @@ void FurnaceGUI::drawSettings() {
           settingsChanged=true;
         }
 
+        bool chanOscTextureB=settings.chanOscTexture;
+        if (ImGui::Checkbox("Draw per-channel oscilloscope to a texture",&chanOscTextureB)) {
+          settings.chanOscTexture=chanOscTextureB;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip("draws waveforms into a single texture instead of as lines.\nmuch faster when there are lots of channels.");
+        }
+
         bool oscTakesEntireWindowB=settings.oscTakesEntireWindow;
         if (ImGui::Checkbox("Fill entire window",&oscTakesEntireWindowB)) {
           settings.oscTakesEntireWindow=oscTakesEntireWindowB;
@@ -3802,9 +3872,12 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     settings.renderBackend=conf.getString("renderBackend",GUI_BACKEND_DEFAULT_NAME);
     settings.renderClearPos=conf.getInt("renderClearPos",0);
+    settings.renderCache=conf.getInt("renderCache",0);
+    settings.visualizerRate=conf.getInt("visualizerRate",0);
 
     settings.chanOscThreads=conf.getInt("chanOscThreads",0);
     settings.renderPoolThreads=conf.getInt("renderPoolThreads",0);
+    settings.sampleFormatBudget=conf.getInt("sampleFormatBudget",0);
     settings.showPool=conf.getInt("showPool",0);
     settings.writeInsNames=conf.getInt("writeInsNames",0);
     settings.readInsNames=conf.getInt("readInsNames",1);
@@ -3822,6 +3895,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     settings.saveUnusedPatterns=conf.getInt("saveUnusedPatterns",0);
     settings.maxRecentFile=conf.getInt("maxRecentFile",10);
+    settings.maxUndoMemory=conf.getInt("maxUndoMemory",64);
 
     settings.persistFadeOut=conf.getInt("persistFadeOut",1);
     settings.exportLoops=conf.getInt("exportLoops",0);
@@ -3833,6 +3907,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     settings.iCannotWait=conf.getInt("iCannotWait",0);
 
     settings.compress=conf.getInt("compress",1);
+    settings.compressChunked=conf.getInt("compressChunked",0);
     settings.newPatternFormat=conf.getInt("newPatternFormat",1);
     settings.newSongBehavior=conf.getInt("newSongBehavior",0);
     settings.playOnLoad=conf.getInt("playOnLoad",0);
@@ -3857,6 +3932,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     settings.audioChans=conf.getInt("audioChans",2);
 
     settings.lowLatency=conf.getInt("lowLatency",0);
+    settings.precompiledPlayback=conf.getInt("precompiledPlayback",0);
 
     settings.metroVol=conf.getInt("metroVol",100);
     settings.sampleVol=conf.getInt("sampleVol",50);
@@ -3960,6 +4036,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     settings.oscEscapesBoundary=conf.getInt("oscEscapesBoundary",0);
     settings.oscMono=conf.getInt("oscMono",1);
     settings.oscAntiAlias=conf.getInt("oscAntiAlias",1);
+    settings.chanOscTexture=conf.getInt("chanOscTexture",1);
 
     settings.channelColors=conf.getInt("channelColors",1);
     settings.channelTextColors=conf.getInt("channelTextColors",0);
@@ -4165,8 +4242,11 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
   clampSetting(settings.oplStandardWaveNames,0,1);
   clampSetting(settings.cursorMoveNoScroll,0,1);
   clampSetting(settings.lowLatency,0,1);
+  clampSetting(settings.precompiledPlayback,0,1);
   clampSetting(settings.notePreviewBehavior,0,3);
   clampSetting(settings.powerSave,0,1);
+  clampSetting(settings.renderCache,0,1);
+  clampSetting(settings.visualizerRate,0,240);
   clampSetting(settings.absorbInsInput,0,1);
   clampSetting(settings.eventDelay,0,1);
   clampSetting(settings.moveWindowTitle,0,1);
@@ -4197,6 +4277,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
   clampSetting(settings.channelFont,0,1);
   clampSetting(settings.channelTextCenter,0,1);
   clampSetting(settings.maxRecentFile,0,30);
+  clampSetting(settings.maxUndoMemory,1,4096);
   clampSetting(settings.midiOutClock,0,1);
   clampSetting(settings.midiOutTime,0,1);
   clampSetting(settings.midiOutProgramChange,0,1);
@@ -4214,6 +4295,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
   clampSetting(settings.iCannotWait,0,1);
   clampSetting(settings.orderButtonPos,0,2);
   clampSetting(settings.compress,0,1);
+  clampSetting(settings.compressChunked,0,1);
   clampSetting(settings.newPatternFormat,0,1);
   clampSetting(settings.renderClearPos,0,1);
   clampSetting(settings.insertBehavior,0,1);
@@ -4233,7 +4315,9 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
   clampSetting(settings.exportOptionsLayout,0,2);
   clampSetting(settings.wasapiEx,0,1);
   clampSetting(settings.chanOscThreads,0,256);
+  clampSetting(settings.chanOscTexture,0,1);
   clampSetting(settings.renderPoolThreads,0,DIV_MAX_CHIPS);
+  clampSetting(settings.sampleFormatBudget,0,16384);
   clampSetting(settings.showPool,0,1);
   clampSetting(settings.writeInsNames,0,1);
   clampSetting(settings.readInsNames,0,1);
@@ -4267,9 +4351,12 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     conf.set("renderBackend",settings.renderBackend);
     conf.set("renderClearPos",settings.renderClearPos);
+    conf.set("renderCache",settings.renderCache);
+    conf.set("visualizerRate",settings.visualizerRate);
     
     conf.set("chanOscThreads",settings.chanOscThreads);
     conf.set("renderPoolThreads",settings.renderPoolThreads);
+    conf.set("sampleFormatBudget",settings.sampleFormatBudget);
     conf.set("showPool",settings.showPool);
     conf.set("writeInsNames",settings.writeInsNames);
     conf.set("readInsNames",settings.readInsNames);
@@ -4287,6 +4374,7 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     
     conf.set("saveUnusedPatterns",settings.saveUnusedPatterns);
     conf.set("maxRecentFile",settings.maxRecentFile);
+    conf.set("maxUndoMemory",settings.maxUndoMemory);
     
     conf.set("persistFadeOut",settings.persistFadeOut);
     conf.set("exportLoops",settings.exportLoops);
@@ -4298,6 +4386,7 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     conf.set("iCannotWait",settings.iCannotWait);
 
     conf.set("compress",settings.compress);
+    conf.set("compressChunked",settings.compressChunked);
     conf.set("newPatternFormat",settings.newPatternFormat);
     conf.set("newSongBehavior",settings.newSongBehavior);
     conf.set("playOnLoad",settings.playOnLoad);
@@ -4316,6 +4405,7 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     conf.set("audioChans",settings.audioChans);
 
     conf.set("lowLatency",settings.lowLatency);
+    conf.set("precompiledPlayback",settings.precompiledPlayback);
 
     conf.set("metroVol",settings.metroVol);
     conf.set("sampleVol",settings.sampleVol);
@@ -4424,6 +4514,7 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     conf.set("oscEscapesBoundary",settings.oscEscapesBoundary);
     conf.set("oscMono",settings.oscMono);
     conf.set("oscAntiAlias",settings.oscAntiAlias);
+    conf.set("chanOscTexture",settings.chanOscTexture);
 
     conf.set("channelColors",settings.channelColors);
     conf.set("channelTextColors",settings.channelTextColors);
@@ -74,6 +74,8 @@ bool consoleMode=true;
 bool displayEngineFailError=false;
 bool cmdOutBinary=false;
 bool vgmOutDirect=false;
+bool cmdPlay=false;
+bool lowLatencyMode=false;
 
 bool safeMode=false;
 bool safeModeWithAudio=false;
@@ -163,6 +165,16 @@ TAParamResult pDirect(String val) {
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pCmdPlay(String val) {
+  cmdPlay=true;
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pLowLatency(String val) {
+  lowLatencyMode=true;
+  return TA_PARAM_SUCCESS;
+}
+
 TAParamResult pInfo(String val) {
   infoMode=true;
   return TA_PARAM_SUCCESS;
@@ -323,8 +335,10 @@ TAParamResult pBenchmark(String val) {
     benchMode=1;
   } else if (val=="seek") {
     benchMode=2;
+  } else if (val=="cmdstream") {
+    benchMode=3;
   } else {
-    logE("invalid value for benchmark! valid values are: render and seek.");
+    logE("invalid value for benchmark! valid values are: render, seek and cmdstream.");
     return TA_PARAM_ERROR;
   }
   e.setAudio(DIV_AUDIO_DUMMY);
@@ -374,6 +388,8 @@ void initParams() {
   params.push_back(TAParam("Z","zsmout",true,pZSMOut,"<filename>","output .zsm data for Commander X16 Zsound"));
   params.push_back(TAParam("C","cmdout",true,pCmdOut,"<filename>","output command stream"));
   params.push_back(TAParam("b","binary",false,pBinary,"","set command stream output format to binary"));
+  params.push_back(TAParam("P","cmdplay",false,pCmdPlay,"","play/render from a precompiled command stream instead of patterns"));
+  params.push_back(TAParam("y","lowlatency",false,pLowLatency,"","enable low-latency mode (tick the engine more often)"));
   params.push_back(TAParam("L","loglevel",true,pLogLevel,"debug|info|warning|error","set the log level (info by default)"));
   params.push_back(TAParam("v","view",true,pView,"pattern|commands|nothing","set visualization (nothing by default)"));
   params.push_back(TAParam("i","info",false,pInfo,"","get info about a song"));
@@ -385,7 +401,7 @@ void initParams() {
   params.push_back(TAParam("S","safemode",false,pSafeMode,"","enable safe mode (software rendering and no audio)"));
   params.push_back(TAParam("A","safeaudio",false,pSafeModeAudio,"","enable safe mode (with audio"));
 
-  params.push_back(TAParam("B","benchmark",true,pBenchmark,"render|seek","run performance test"));
+  params.push_back(TAParam("B","benchmark",true,pBenchmark,"render|seek|cmdstream","run performance test"));
 
   params.push_back(TAParam("V","version",false,pVersion,"","view information about Furnace."));
   params.push_back(TAParam("W","warranty",false,pWarranty,"","view warranty disclaimer."));
@@ -619,7 +635,7 @@ int main(int argc, char** argv) {
       return 1;
     }
     fclose(f);
-    if (!e.load(file,(size_t)len)) {
+    if (!e.load(file,(size_t)len,infoMode)) {
       reportError(fmt::sprintf("could not open file! (%s)",e.getLastError()));
       e.everythingOK();
       finishLogFile();
@@ -647,9 +663,19 @@ int main(int argc, char** argv) {
     e.changeSongP(subsong);
   }
 
+  if (cmdPlay) {
+    e.setPrecompiledPlayback(true);
+  }
+
+  if (lowLatencyMode) {
+    e.setLowLatency(true);
+  }
+
   if (benchMode) {
     logI("starting benchmark!");
-    if (benchMode==2) {
+    if (benchMode==3) {
+      e.benchmarkCommandStream();
+    } else if (benchMode==2) {
       e.benchmarkSeek();
     } else {
       e.benchmarkPlayback();
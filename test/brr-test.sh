@@ -0,0 +1,15 @@
+#!/bin/bash
+# checks whether the BRR encoder and decoder in src/engine/brrUtils.c produce
+# the same output as the reference implementation in test/brr_ref.c.
+# useful when doing changes to brrUtils.c.
+
+echo "compiling brr_compare..."
+gcc -O2 -Wall -Wextra -Werror -I"src/engine" -o "test/brr_compare" "test/brr_compare.c" "test/brr_ref.c" "src/engine/brrUtils.c" -lm || exit 1
+
+echo "furnace BRR test begin..."
+if ./test/brr_compare; then
+  echo "[1;32mOK[m"
+else
+  echo "[1;31mFAIL FAIL FAIL[m"
+  exit 1
+fi
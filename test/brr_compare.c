@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "brrUtils.h"
+
+#define TEST_COUNT 4000
+#define MAX_LEN 4096
+
+// brr_ref.c
+long refBrrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigned char emphasis);
+long refBrrDecode(unsigned char* buf, short* out, long len, unsigned char emphasis);
+
+static const char* kindNames[5]={
+  "random", "sine", "quiet", "square", "full-scale random"
+};
+
+// fixed generator so that results don't depend on the C library
+static unsigned int seed=1;
+static unsigned int nextRand() {
+  seed^=seed<<13;
+  seed^=seed>>17;
+  seed^=seed<<5;
+  return seed;
+}
+
+static void fill(short* buf, long len, int kind, int t) {
+  for (long i=0; i<len; i++) {
+    switch (kind) {
+      case 0: // random
+        buf[i]=(short)((int)(nextRand()%32768)-16384);
+        break;
+      case 1: // sine
+        buf[i]=(short)(32000*sin((double)i*0.01*(double)(t%17+1)));
+        break;
+      case 2: // quiet
+        buf[i]=(short)((int)(nextRand()%64)-32);
+        break;
+      case 3: // square
+        buf[i]=((i/(t%50+3))&1)?32767:-32768;
+        break;
+      default: // full-scale random
+        buf[i]=(short)(nextRand()&0xffff);
+        break;
+    }
+  }
+}
+
+// usage: brr_compare
+// encodes and decodes generated buffers (looped and unlooped, with and without emphasis)
+// with both brrUtils.c and the reference implementation, and compares the results.
+// return values:
+// - 0: pass (output is identical)
+// - 1: fail (mismatch found)
+int main(void) {
+  int failed=0;
+  short* buf=malloc(MAX_LEN*sizeof(short));
+  unsigned char* encRef=malloc(9*((15+MAX_LEN)/16)+9);
+  unsigned char* encNew=malloc(9*((15+MAX_LEN)/16)+9);
+  short* decRef=malloc(16*((15+MAX_LEN)/16+1)*sizeof(short));
+  short* decNew=malloc(16*((15+MAX_LEN)/16+1)*sizeof(short));
+
+  for (int t=0; t<TEST_COUNT; t++) {
+    long len=1+(long)(nextRand()%MAX_LEN);
+    int kind=t%5;
+    long loopStart=(t&1)?(long)(nextRand()%len):-1;
+    unsigned char emphasis=(t>>1)&1;
+    fill(buf,len,kind,t);
+
+    memset(encRef,0,9*((15+MAX_LEN)/16)+9);
+    memset(encNew,0,9*((15+MAX_LEN)/16)+9);
+    long encLenRef=refBrrEncode(buf,encRef,len,loopStart,emphasis);
+    long encLenNew=brrEncode(buf,encNew,len,loopStart,emphasis);
+    if (encLenRef!=encLenNew || memcmp(encRef,encNew,encLenRef)!=0) {
+      printf("%d: encode mismatch (%s, length %ld, loop %ld, emphasis %d)\n",t,kindNames[kind],len,loopStart,emphasis);
+      failed++;
+      continue;
+    }
+
+    long decLenRef=refBrrDecode(encRef,decRef,encLenRef,emphasis);
+    long decLenNew=brrDecode(encRef,decNew,encLenRef,emphasis);
+    if (decLenRef!=decLenNew || memcmp(decRef,decNew,decLenRef*sizeof(short))!=0) {
+      printf("%d: decode mismatch (%s, length %ld, loop %ld, emphasis %d)\n",t,kindNames[kind],len,loopStart,emphasis);
+      failed++;
+    }
+  }
+
+  free(buf);
+  free(encRef);
+  free(encNew);
+  free(decRef);
+  free(decNew);
+
+  printf("%d/%d buffers identical.\n",TEST_COUNT-failed,TEST_COUNT);
+  return failed?1:0;
+}
@@ -0,0 +1,40 @@
+#!/bin/bash
+# renders all files in test/songs/ both from patterns and from a precompiled
+# command stream (-cmdplay), and checks whether the results match.
+# a second pass renders one more loop in low-latency mode, both from patterns and from
+# the command stream, to check the hand-over to patterns at the loop point.
+# requires GNU parallel.
+
+testDir=$(date +%Y%m%d%H%M%S)
+
+if [ -e "test/assert_delta" ]; then
+  echo "assert_delta present."
+else
+  echo "compiling assert_delta..."
+  gcc -Wall -Wextra -Werror -o "test/assert_delta" "test/assert_delta.c" -lsndfile || exit 1
+fi
+
+echo "furnace precompiled playback test begin..."
+echo "--- STEP 1: render test files"
+mkdir -p "test/cmdplay/$testDir/pattern" || exit 1
+mkdir -p "test/cmdplay/$testDir/stream" || exit 1
+mkdir -p "test/cmdplay/$testDir/patternLoop" || exit 1
+mkdir -p "test/cmdplay/$testDir/streamLL" || exit 1
+ls "test/songs/" | parallel --verbose -j8 ./build/furnace -loops 0 -output "test/cmdplay/$testDir/pattern/{0}.wav" "test/songs/{0}"
+ls "test/songs/" | parallel --verbose -j8 ./build/furnace -loops 0 -cmdplay -output "test/cmdplay/$testDir/stream/{0}.wav" "test/songs/{0}"
+ls "test/songs/" | parallel --verbose -j8 ./build/furnace -loops 1 -lowlatency -output "test/cmdplay/$testDir/patternLoop/{0}.wav" "test/songs/{0}"
+ls "test/songs/" | parallel --verbose -j8 ./build/furnace -loops 1 -cmdplay -lowlatency -output "test/cmdplay/$testDir/streamLL/{0}.wav" "test/songs/{0}"
+echo "--- STEP 2: calculate deltas"
+mkdir -p "test/cmdplay/$testDir/delta" || exit 1
+mkdir -p "test/cmdplay/$testDir/deltaLL" || exit 1
+ls "test/cmdplay/$testDir/pattern/" | parallel --verbose -j4 ffmpeg -loglevel fatal -i "test/cmdplay/$testDir/pattern/{0}" -i "test/cmdplay/$testDir/stream/{0}" -filter_complex stereotools=phasel=1:phaser=1,amix=inputs=2:duration=longest -c:a pcm_s16le -y "test/cmdplay/$testDir/delta/{0}"
+ls "test/cmdplay/$testDir/pattern/" | parallel --verbose -j4 ffmpeg -loglevel fatal -i "test/cmdplay/$testDir/patternLoop/{0}" -i "test/cmdplay/$testDir/streamLL/{0}" -filter_complex stereotools=phasel=1:phaser=1,amix=inputs=2:duration=longest -c:a pcm_s16le -y "test/cmdplay/$testDir/deltaLL/{0}"
+echo "--- STEP 3: check deltas"
+for i in `ls "test/cmdplay/$testDir/delta"`; do
+  echo -n "$i... "
+  if ./test/assert_delta "test/cmdplay/$testDir/delta/$i" && ./test/assert_delta "test/cmdplay/$testDir/deltaLL/$i"; then
+    echo "[1;32mOK[m"
+  else
+    echo "[1;31mFAIL FAIL FAIL[m"
+  fi
+done